@@ -7,6 +7,25 @@
 #include <array>
 #include <cstdio>
 #include <optional>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <unordered_map>
+#include <list>
+#include <future>
+#include <chrono>
+#include <cstring>
+#include <string>
+
+// NoiseChunkFile maps files with mmap on POSIX systems and reads them in
+// whole elsewhere or with BOAR_NO_MMAP
+#if !defined(BOAR_NO_MMAP) && (defined(__unix__) || defined(__APPLE__))
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+    #define BOAR_HAS_MMAP
+#endif
 
 using std::vector;
 
@@ -15,411 +34,3740 @@ using std::vector;
 namespace boar {
     
 
-    class A_Star {
+    // Binary min-heap that keeps each item's position in the heap up to date,
+    // so an item already queued can be re-prioritized in place.
+    // Handle must return a reference to the uint32_t slot where the item's
+    // heap position is stored.
+    template<typename Item, typename Less, typename Handle>
+    class IndexedHeap {
 
-        enum class node_state {
-            open,
-            closed,
-            none
-        };
+        private:
 
-        class Node {
+            vector<Item> items;
+            Less less;
+            Handle handle;
 
-            public:
-                
-                Vector2ui pos;
-                uint32_t h;
-                uint8_t g;
+        public:
 
-                node_state state;
+            IndexedHeap(Less less = Less(), Handle handle = Handle())
+            : less(less), handle(handle) {}
 
-                bool root;
-                Node* parent;
+            [[nodiscard]]
+            inline bool empty() const noexcept {
+                return this->items.empty();
+            }
 
-                Node(Vector2ui pos, bool root, Node* parent)
-                : pos(pos), root(root), parent(parent) {
-                    g = 0;
-                    h = 0;
-                    this->state = node_state::none;
-                }
+            [[nodiscard]]
+            inline std::size_t size() const noexcept {
+                return this->items.size();
+            }
 
-                [[nodiscard]]
-                inline uint32_t get_f() const noexcept {
-                    return this->g + this->h;
+            [[nodiscard]]
+            inline const Item& top() const noexcept {
+                return this->items.front();
+            }
+
+            inline const vector<Item>& data() const noexcept {
+                return this->items;
+            }
+
+            // The item at a heap position, a key change must be followed by
+            // decrease() or update()
+            inline Item& at(uint32_t position) noexcept {
+                return this->items[position];
+            }
+
+            inline void clear() noexcept {
+                this->items.clear();
+            }
+
+            void push(Item item) {
+                this->items.push_back(item);
+                this->handle(this->items.back()) = static_cast<uint32_t>(this->items.size() - 1);
+                this->sift_up(static_cast<uint32_t>(this->items.size() - 1));
+            }
+
+            Item pop() noexcept {
+                Item result = this->items.front();
+                this->items.front() = this->items.back();
+                this->handle(this->items.front()) = 0;
+                this->items.pop_back();
+                if (!this->items.empty()) {
+                    this->sift_down(0);
                 }
+                return result;
+            }
 
-        };
+            // Restores the heap after the item's key got smaller
+            inline void decrease(const Item& item) noexcept {
+                this->sift_up(this->handle(item));
+            }
+
+            // Restores the heap after the item's key changed either way
+            inline void update(const Item& item) noexcept {
+                this->sift_up(this->handle(item));
+                this->sift_down(this->handle(item));
+            }
+
+            void remove(const Item& item) noexcept {
+                const uint32_t i = this->handle(item);
+                const Item last = this->items.back();
+                this->items.pop_back();
+                if (i < this->items.size()) {
+                    this->items[i] = last;
+                    this->handle(this->items[i]) = i;
+                    this->update(last);
+                }
+            }
 
         private:
 
-            uint8_t ORTHOGONAL_COST = 10;
-            uint8_t DIAGONAL_COST   = 14;
-            
-            bool diagonal_move;
-            vector<Vector2i> directions;
+            void sift_up(uint32_t i) noexcept {
+                Item item = this->items[i];
+                while (i > 0) {
+                    const uint32_t parent = (i - 1) / 2;
+                    if (!this->less(item, this->items[parent])) {
+                        break;
+                    }
+                    this->items[i] = this->items[parent];
+                    this->handle(this->items[i]) = i;
+                    i = parent;
+                }
+                this->items[i] = item;
+                this->handle(this->items[i]) = i;
+            }
 
-            Vector2ui* target = nullptr;
-            Vector2ui* current = nullptr;
+            void sift_down(uint32_t i) noexcept {
+                const uint32_t size = static_cast<uint32_t>(this->items.size());
+                Item item = this->items[i];
+                while (true) {
+                    uint32_t child = 2 * i + 1;
+                    if (child >= size) {
+                        break;
+                    }
+                    if (child + 1 < size && this->less(this->items[child + 1], this->items[child])) {
+                        child++;
+                    }
+                    if (!this->less(this->items[child], item)) {
+                        break;
+                    }
+                    this->items[i] = this->items[child];
+                    this->handle(this->items[i]) = i;
+                    i = child;
+                }
+                this->items[i] = item;
+                this->handle(this->items[i]) = i;
+            }
+    };
 
-            const uint32_t MAP_SIZE_X;
-            const uint32_t MAP_SIZE_Y;
 
-            bool at_side;
-            bool add_target_to_result;
+    // One bit per tile, row-major, set bits are passable. It works as an A_Star
+    // tile validator, and Basic_A_Star<PassabilityGrid> reads all the neighbors
+    // of a tile with a few word loads instead of one validator call each.
+    // Its size must match the map size given to the A_Star
+    class PassabilityGrid {
 
-            const std::function<bool(Vector2i&)> extern_validade_tile;
+        private:
 
-            vector<vector<Node*>> internal_nodes;
+            uint32_t size_x;
+            uint32_t size_y;
 
+            // rows carry a blocked border tile on each side and a spare word,
+            // so neighbor reads never need bounds checks
+            uint32_t words_per_row;
+            vector<uint64_t> bits;
 
         public:
 
-            A_Star (bool diagonal_move, uint32_t map_size_x, uint32_t map_size_y,
-                    std::function<bool(Vector2i&)> extern_validade_tile)
-            : diagonal_move(diagonal_move), MAP_SIZE_X(map_size_x), 
-              MAP_SIZE_Y(map_size_y), extern_validade_tile(extern_validade_tile) {
-
-                  this->at_side = false;
-                  this->add_target_to_result = false;
+            PassabilityGrid(uint32_t size_x, uint32_t size_y, bool passable = false)
+            : size_x(size_x), size_y(size_y) {
 
-                this->directions.push_back({0, -1});
-                this->directions.push_back({1, 0});
-                this->directions.push_back({0, 1});
-                this->directions.push_back({-1, 0});
+                this->words_per_row = (size_x + 2) / 64 + 2;
+                this->bits.resize(static_cast<std::size_t>(this->words_per_row) * (size_y + 2), 0);
 
-                if (this->diagonal_move) {
-                    this->directions.push_back({1, -1});
-                    this->directions.push_back({1, 1});
-                    this->directions.push_back({-1, -1});
-                    this->directions.push_back({-1, 1});
+                if (passable) {
+                    for (uint32_t y = 0; y < size_y; y++) {
+                        for (uint32_t x = 0; x < size_x; x++) {
+                            this->set(x, y, true);
+                        }
+                    }
                 }
+            }
+
+            [[nodiscard]]
+            inline uint32_t get_size_x() const noexcept {
+                return this->size_x;
+            }
+
+            [[nodiscard]]
+            inline uint32_t get_size_y() const noexcept {
+                return this->size_y;
+            }
+
+            inline void set(uint32_t x, uint32_t y, bool passable) noexcept {
 
-                this->internal_nodes.resize(this->MAP_SIZE_X);
-                for (auto& i: this->internal_nodes) {
-                    i.resize(this->MAP_SIZE_Y);
+                const std::size_t bit = this->bit_of(x + 1, y + 1);
+                if (passable) {
+                    this->bits[bit / 64] |= uint64_t{1} << (bit % 64);
                 }
-                for (auto& i: this->internal_nodes) {
-                    for (uint32_t j = 0; j < this->MAP_SIZE_Y; j++) {
-                        i[j] = nullptr;
-                    }
+                else {
+                    this->bits[bit / 64] &= ~(uint64_t{1} << (bit % 64));
                 }
             }
 
-            ~A_Star() {
-                for (auto& i: this->internal_nodes) {
-                    for (auto& j: i) {
-                        if (j != nullptr) {
-                            delete j;
-                        }
-                    }
+            [[nodiscard]]
+            inline bool get(uint32_t x, uint32_t y) const noexcept {
+
+                const std::size_t bit = this->bit_of(x + 1, y + 1);
+                return (this->bits[bit / 64] >> (bit % 64)) & 1;
+            }
+
+            [[nodiscard]]
+            inline bool operator()(const Vector2i& pos) const noexcept {
+
+                if (pos.x < 0 || pos.y < 0 || (uint32_t)pos.x >= this->size_x || (uint32_t)pos.y >= this->size_y) {
+                    return false;
                 }
+                return this->get(pos.x, pos.y);
             }
 
-            void set_at_side(bool at_side, bool add_target_to_result) noexcept {
-                this->at_side = at_side;
-                this->add_target_to_result = add_target_to_result;
+            // Passable neighbors of (x, y) in A_Star's direction order:
+            // N, E, S, W, NE, SE, NW, SW on bits 0 to 7
+            [[nodiscard]]
+            inline uint8_t neighbor_mask(uint32_t x, uint32_t y) const noexcept {
+
+                // three bits per row, for columns x - 1, x and x + 1
+                const uint32_t top = this->row_bits(x, y);
+                const uint32_t mid = this->row_bits(x, y + 1);
+                const uint32_t bot = this->row_bits(x, y + 2);
+
+                return static_cast<uint8_t>(
+                    ((top >> 1) & 1)        | ((mid >> 2) & 1) << 1 |
+                    ((bot >> 1) & 1) << 2   | (mid & 1) << 3        |
+                    ((top >> 2) & 1) << 4   | ((bot >> 2) & 1) << 5 |
+                    (top & 1) << 6          | (bot & 1) << 7
+                );
             }
 
-            std::optional<vector<Vector2ui>> find(Vector2ui start, Vector2ui target) noexcept {
-                this->target = &target;
+        private:
 
-                bool success = false;
-                std::vector<Vector2ui> result;
+            [[nodiscard]]
+            inline std::size_t bit_of(uint32_t padded_x, uint32_t padded_y) const noexcept {
+                return static_cast<std::size_t>(padded_y) * this->words_per_row * 64 + padded_x;
+            }
 
-                {
-                    uint8_t i = 0;
-                    for (; i < this->directions.size(); i ++) {
-                        if (this->validate_neighbor((Vector2i)target + this->directions[i])) {
-                            break;
-                        }
-                    }
-                    if (i == this->directions.size()){
-                        return {};
-                    }
-                }
+            [[nodiscard]]
+            inline uint32_t row_bits(uint32_t padded_x, uint32_t padded_y) const noexcept {
 
-                std::vector<Node*> open_list;
-                std::vector<Node*> closed_list;
+                const std::size_t bit = this->bit_of(padded_x, padded_y);
+                const std::size_t word = bit / 64;
+                const uint32_t shift = bit % 64;
 
-                {
-                    Node* start_node = this->get_node(start, true, nullptr);
-                    start_node->g = 0;
-                    this->calculate_h(*start_node);
-                    
-                    start_node->state = node_state::open;
-                    open_list.push_back(start_node);
+                uint64_t value = this->bits[word] >> shift;
+                if (shift > 61) {
+                    value |= this->bits[word + 1] << (64 - shift);
                 }
+                return static_cast<uint32_t>(value & 7);
+            }
+    };
 
-                while (open_list.size() != 0) {
 
-                    std::sort(open_list.begin(), open_list.end(),
-                        [](Node* a, Node* b) {
-                            return a->get_f() < b->get_f();
-                        }
-                    );
+    // LRU cache of found paths, keyed by start, target and the finder's
+    // Config, so A_Stars that move or weigh tiles differently never share paths.
+    // The map is split in square regions with a version counter each, an entry
+    // remembers the versions of the regions its path crosses and is dropped
+    // on lookup once one of them moved on. mark_dirty() only catches paths
+    // through the changed tile's region, a tile that opens up elsewhere can
+    // leave a cached path valid but no longer the shortest.
+    // Failed searches are not cached. It is safe to share between threads,
+    // and must only serve A_Stars on the same map
+    class PathCache {
 
-                    Node* current = open_list.at(0);
-                    current->state = node_state::closed;
-                    closed_list.push_back(current);
-                    open_list.erase(open_list.begin());
+        public:
 
+            struct Stats {
+                uint64_t hits = 0;
+                uint64_t misses = 0;
+                uint64_t evictions = 0;
+                uint64_t invalidations = 0;
+            };
 
-                    this->current = &current->pos;
+            // What a finder's paths depend on besides the map and the query
+            struct Config {
+                bool diagonal_move = false;
+                bool at_side = false;
+                bool add_target_to_result = false;
+                bool jump_point_search = false;
+                bool bidirectional = false;
+                // the tile cost policy searched with, nullptr for uniform costs
+                const void* tile_cost = nullptr;
+            };
 
-                    if (current->pos == target) {
-                        result = this->get_path(current);
-                        success = true;
-                        goto end;
-                    }
-                    
-                    Vector2ui neighbor_pos {0, 0};
-                    Vector2i poss_neighbor_pos {0, 0};
-                    Node* neighbor = nullptr;
+        private:
 
-                    for (uint8_t i = 0; i < this->directions.size(); i++) {
-                        
-                        poss_neighbor_pos = current->pos + this->directions[i];
-
-                        if (this->at_side && poss_neighbor_pos == target) { 
-                            if (this->diagonal_move || current->pos.OrthogonalTo(poss_neighbor_pos)) {
-                                
-                                result = this->get_path(current);
-                                if (this->add_target_to_result) {
-                                    result.push_back(target);
-                                }
-                                success = true;
-                                goto end;
-                            } 
-                        }
+            struct Key {
+                Vector2ui start;
+                Vector2ui target;
+                uint8_t flags;
+                const void* tile_cost;
 
-                        if (!this->validate_neighbor(poss_neighbor_pos)) {
-                            continue;
-                        }
+                inline bool operator==(const Key& other) const noexcept {
+                    return this->start == other.start && this->target == other.target &&
+                           this->flags == other.flags && this->tile_cost == other.tile_cost;
+                }
+            };
 
-                        neighbor_pos = poss_neighbor_pos;
+            struct KeyHash {
+                inline std::size_t operator()(const Key& key) const noexcept {
+                    uint64_t hash = (uint64_t(key.start.x) << 32 | key.start.y) * 0x9E3779B97F4A7C15ull;
+                    hash ^= (uint64_t(key.target.x) << 32 | key.target.y) + 0x632BE59BD9B4E019ull + (hash << 6) + (hash >> 2);
+                    hash ^= reinterpret_cast<uintptr_t>(key.tile_cost) + 0x9E3779B97F4A7C15ull + (hash << 6) + (hash >> 2);
+                    return static_cast<std::size_t>(hash ^ key.flags);
+                }
+            };
 
-                        if (this->internal_nodes[neighbor_pos.x][neighbor_pos.y] != nullptr) {
+            struct Entry {
+                Key key;
+                vector<Vector2ui> path;
+                // (region, version) pairs of every region the path crosses
+                vector<std::pair<uint32_t, uint32_t>> regions;
+            };
 
-                            if (this->internal_nodes[neighbor_pos.x][neighbor_pos.y]->state == node_state::closed) {
-                                continue;
-                            }
+            using EntryList = std::list<Entry>;
 
-                            else if (this->internal_nodes[neighbor_pos.x][neighbor_pos.y]->state == node_state::open) {
+            const std::size_t capacity;
+            const uint32_t region_size;
+            const uint32_t regions_x;
 
-                                neighbor = this->internal_nodes[neighbor_pos.x][neighbor_pos.y];
+            vector<uint32_t> versions;
+            EntryList entries;
+            std::unordered_map<Key, EntryList::iterator, KeyHash> index;
+            Stats counters;
 
-                                uint8_t mov_cost = this->ORTHOGONAL_COST;
-                                if (this->diagonal_move) {
-                                    if (current->pos.DiagonalTo(neighbor->pos)) {
-                                        mov_cost = DIAGONAL_COST;
-                                    }
-                                }
+            mutable std::mutex mutex;
 
-                                uint8_t better_g = current->g + mov_cost;
-                                if (better_g < neighbor->g) {
-                                    neighbor->parent = current;
-                                    neighbor->g = better_g;
-                                }
+        public:
 
-                            }
-                        }
+            PathCache(std::size_t capacity, uint32_t map_size_x, uint32_t map_size_y, uint32_t region_size = 16)
+            : capacity(std::max<std::size_t>(1, capacity)), region_size(std::max<uint32_t>(1, region_size)),
+              regions_x((map_size_x + this->region_size - 1) / this->region_size) {
 
-                        if (this->internal_nodes[neighbor_pos.x][neighbor_pos.y] == nullptr ||
-                            this->internal_nodes[neighbor_pos.x][neighbor_pos.y]->state == node_state::none) {
+                const uint32_t regions_y = (map_size_y + this->region_size - 1) / this->region_size;
+                this->versions.resize(static_cast<std::size_t>(this->regions_x) * regions_y, 0);
+            }
 
-                            neighbor = this->get_node(neighbor_pos, false, current);
-                            neighbor->h = this->calculate_h(*neighbor);
-                            neighbor->g = this->calculate_g(*current, *neighbor);
-                            
-                            neighbor->state = node_state::open;
-                            open_list.push_back(neighbor);
-                            neighbor = nullptr;
-                        }
-                    }
-                }
+            PathCache(const PathCache&) = delete;
+            PathCache& operator=(const PathCache&) = delete;
 
-                end:;
+            std::optional<vector<Vector2ui>> lookup(Vector2ui start, Vector2ui target, const Config& config) {
 
-                for (auto& i: open_list) {
-                    i->state = node_state::none;
-                }
-                for (auto& i: closed_list) {
-                    i->state = node_state::none;
-                }
+                const std::lock_guard<std::mutex> lock(this->mutex);
 
-                if (success)
-                    return {result};
-                else
+                const auto found = this->index.find(key_of(start, target, config));
+                if (found == this->index.end()) {
+                    this->counters.misses++;
                     return {};
+                }
 
+                const EntryList::iterator entry = found->second;
+                for (const auto& [region, version] : entry->regions) {
+                    if (this->versions[region] != version) {
+                        this->index.erase(found);
+                        this->entries.erase(entry);
+                        this->counters.invalidations++;
+                        this->counters.misses++;
+                        return {};
+                    }
+                }
+
+                this->entries.splice(this->entries.begin(), this->entries, entry);
+                this->counters.hits++;
+                return {entry->path};
             }
 
-        private:
+            void store(Vector2ui start, Vector2ui target, const Config& config, const vector<Vector2ui>& path) {
 
-            vector<Vector2ui> get_path(Node* curr) const noexcept {
+                Entry entry {key_of(start, target, config), path, {}};
 
-                vector<Vector2ui> result;
-                while (true) {
-                    if (curr->root) {
-                        return result;
-                    }
-                    else {
-                        result.insert(result.begin(), curr->pos);
-                        curr = curr->parent;
-                    }
+                const std::lock_guard<std::mutex> lock(this->mutex);
+
+                this->add_region(entry, start);
+                for (const Vector2ui& tile : path) {
+                    this->add_region(entry, tile);
+                }
+
+                const auto found = this->index.find(entry.key);
+                if (found != this->index.end()) {
+                    this->entries.erase(found->second);
+                    this->index.erase(found);
+                }
+                else if (this->entries.size() >= this->capacity) {
+                    this->index.erase(this->entries.back().key);
+                    this->entries.pop_back();
+                    this->counters.evictions++;
                 }
 
+                this->entries.push_front(std::move(entry));
+                this->index[this->entries.front().key] = this->entries.begin();
             }
 
-            inline uint32_t calculate_h(const Node& node) const noexcept {
+            // Call when the tile's passability changed
+            void mark_dirty(Vector2ui tile) {
+                const std::lock_guard<std::mutex> lock(this->mutex);
+                this->versions[this->region_of(tile)]++;
+            }
 
-                Vector2i delta {abs(node.pos.x - (*this->target).x), abs(node.pos.y - (*this->target).y)};
+            void clear() {
+                const std::lock_guard<std::mutex> lock(this->mutex);
+                this->entries.clear();
+                this->index.clear();
+            }
 
-                if (this->diagonal_move) {
-                    // euclidean
-                    return (10 * sqrt(pow(delta.x, 2) + pow(delta.y, 2)));
-                }
-                else {
-                    // manhattan
-                    return (10 * (delta.x + delta.y));
-                }
+            [[nodiscard]]
+            std::size_t size() const {
+                const std::lock_guard<std::mutex> lock(this->mutex);
+                return this->entries.size();
             }
 
             [[nodiscard]]
-            inline uint8_t calculate_g(const Node& curr, const Node& node) const noexcept {
+            Stats stats() const {
+                const std::lock_guard<std::mutex> lock(this->mutex);
+                return this->counters;
+            }
 
-                if (this->diagonal_move && (node.pos.x == curr.pos.x || node.pos.y == curr.pos.y)) {
-                    return this->ORTHOGONAL_COST + curr.g;
-                }
-                else {
-                    return this->DIAGONAL_COST + curr.g;
-                }
+            void reset_stats() {
+                const std::lock_guard<std::mutex> lock(this->mutex);
+                this->counters = Stats();
             }
 
-            [[nodiscard]]
-            inline Node* get_node(Vector2ui& pos, bool root, Node* parent) noexcept {
-                
-                if (this->internal_nodes[pos.x][pos.y] != nullptr) {
-                    Node* node = this->internal_nodes[pos.x][pos.y];
-                    node->parent = parent;
-                    node->root = root;
-                    node->pos = pos;
-                    node->state = node_state::none;
-                    return node;
-                }
-                else {
-                    Node* new_node = new Node(pos, root, parent);
-                    this->internal_nodes[pos.x][pos.y] = new_node;
-                    return new_node;
-                }
+        private:
 
+            static inline Key key_of(const Vector2ui& start, const Vector2ui& target, const Config& config) noexcept {
+                const uint8_t flags = static_cast<uint8_t>(config.diagonal_move) |
+                                      static_cast<uint8_t>(config.at_side) << 1 |
+                                      static_cast<uint8_t>(config.add_target_to_result) << 2 |
+                                      static_cast<uint8_t>(config.jump_point_search) << 3 |
+                                      static_cast<uint8_t>(config.bidirectional) << 4;
+                return {start, target, flags, config.tile_cost};
             }
-    
+
             [[nodiscard]]
-            inline bool validate_neighbor(Vector2i pos) const noexcept {
+            inline uint32_t region_of(const Vector2ui& tile) const noexcept {
+                return (tile.y / this->region_size) * this->regions_x + tile.x / this->region_size;
+            }
 
-                if (pos.x < 0 || (uint32_t)pos.x == this->MAP_SIZE_X || pos.y < 0 || (uint32_t)pos.y == MAP_SIZE_Y) {
-                    return false;
+            // paths are contiguous, so the region is usually the last one added
+            inline void add_region(Entry& entry, const Vector2ui& tile) {
+
+                const uint32_t region = this->region_of(tile);
+                for (auto i = entry.regions.rbegin(); i != entry.regions.rend(); i++) {
+                    if (i->first == region) {
+                        return;
+                    }
                 }
-                return this->extern_validade_tile(pos);
+                entry.regions.push_back({region, this->versions[region]});
             }
-    
     };
 
 
-    class PerlinNoise {
+    // Tile cost policies for Basic_A_Star. A policy has a cost_type, is
+    // called with the tile a step enters and returns the factor the step's
+    // base cost (10 orthogonal, 14 diagonal) is multiplied by, and reports a
+    // lower bound of those factors through min_cost() so the heuristic stays
+    // admissible. Policies with uniform = true are never called, the search
+    // loop then compiles down to the plain unit cost one
 
-        // all of Perlin Noise core math was based on https://github.com/Reputeless/PerlinNoise
+    // Every tile costs the same, the default
+    struct UniformCost {
+        using cost_type = uint32_t;
+        static constexpr bool uniform = true;
+
+        inline cost_type operator()(const Vector2i&) const noexcept {
+            return 1;
+        }
+
+        inline cost_type min_cost() const noexcept {
+            return 1;
+        }
+    };
+
+    // Row-major cost per tile, its size must match the map size given to
+    // the A_Star. min_cost() follows set() down but not up, call
+    // refresh_min_cost() after raising the cheapest tiles for tighter bounds
+    template<typename Cost>
+    class CostGrid {
 
         private:
 
-            std::array<uint8_t, 512> p;
-            double octave_bias = 2;
+            uint32_t size_x;
+            vector<Cost> costs;
+            Cost min;
 
         public:
 
-            PerlinNoise(uint32_t seed = 0) {
-                this->reseed(seed);
+            using cost_type = Cost;
+            static constexpr bool uniform = false;
+
+            CostGrid(uint32_t size_x, uint32_t size_y, Cost cost = 1)
+            : size_x(size_x), costs(static_cast<std::size_t>(size_x) * size_y, cost), min(cost) {}
+
+            inline void set(uint32_t x, uint32_t y, Cost cost) noexcept {
+                this->costs[static_cast<std::size_t>(y) * this->size_x + x] = cost;
+                this->min = std::min(this->min, cost);
             }
 
-            void reseed(uint32_t seed) {
+            [[nodiscard]]
+            inline Cost get(uint32_t x, uint32_t y) const noexcept {
+                return this->costs[static_cast<std::size_t>(y) * this->size_x + x];
+            }
 
-                for (uint16_t i = 0; i < 256; ++i) {
-                    this->p[i] = static_cast<uint8_t>(i);
+            void refresh_min_cost() noexcept {
+                if (!this->costs.empty()) {
+                    this->min = *std::min_element(this->costs.begin(), this->costs.end());
                 }
+            }
 
-                std::shuffle(std::begin(this->p), std::begin(this->p) + 256, std::default_random_engine(seed));
+            inline Cost operator()(const Vector2i& pos) const noexcept {
+                return this->get(pos.x, pos.y);
+            }
 
-                for (uint16_t i = 0; i < 256; ++i) {
-                    this->p[256 + i] = this->p[i];
-                }
+            inline Cost min_cost() const noexcept {
+                return this->min;
             }
+    };
+
+    // Cost from a callback, min_cost must not be above any cost it returns.
+    // The callback must not throw: like the tile validator it is called from
+    // the noexcept search loop, so an exception ends in std::terminate
+    template<typename Cost>
+    class CostCallback {
 
         private:
 
-            // ############################################################################
-            // #                                                                          #
-            // #                               internals                                  #
-            // #                                                                          #
-            // ############################################################################
+            std::function<Cost(const Vector2i&)> cost;
+            Cost min;
 
-            [[nodiscard]]
-            static constexpr double fade(const double t) noexcept {
-                
-                return t * t * t * (t * (t * 6 - 15) + 10);
-            }
+        public:
 
-            [[nodiscard]]
-            static constexpr double lerp(const double t, const double a, const double b) noexcept {
-                
-                return a + t * (b - a);
+            using cost_type = Cost;
+            static constexpr bool uniform = false;
+
+            CostCallback(std::function<Cost(const Vector2i&)> cost, Cost min_cost)
+            : cost(std::move(cost)), min(min_cost) {}
+
+            inline Cost operator()(const Vector2i& pos) const noexcept {
+                return this->cost(pos);
             }
 
-            [[nodiscard]]
-            static constexpr double grad(const std::uint8_t hash, const double x, const double y, const double z) noexcept {
-                
-                const std::uint8_t h = hash & 15;
-                const double u = h < 8 ? x : y;
-                const double v = h < 4 ? y : h == 12 || h == 14 ? x : z;
-                return ((h & 1) == 0 ? u : -u) + ((h & 2) == 0 ? v : -v);
+            inline Cost min_cost() const noexcept {
+                return this->min;
             }
+    };
 
-            [[nodiscard]]
-            static constexpr double weight(const std::int32_t octaves) noexcept {
-                
-                double value = 0;
-                double amplitude = 1;
 
-                for (std::int32_t i = 0; i < octaves; ++i) {
-                    value += amplitude;
-                    amplitude /= 2;
-                }
+    // Lets a validator or tile cost be held through std::ref/std::cref
+    template<typename Validator>
+    struct validator_traits {
+        using type = Validator;
 
-                return value;
-            }
-        
-        public:
+        static inline const Validator& get(const Validator& validator) noexcept {
+            return validator;
+        }
+    };
 
-            [[nodiscard]]
-            double raw_noise(double x = 0, double y = 0, double z = 0) const noexcept {
-                
-                const std::int32_t X = static_cast<std::int32_t>(std::floor(x)) & 255;
-                const std::int32_t Y = static_cast<std::int32_t>(std::floor(y)) & 255;
-                const std::int32_t Z = static_cast<std::int32_t>(std::floor(z)) & 255;
+    template<typename Validator>
+    struct validator_traits<std::reference_wrapper<Validator>> {
+        using type = std::remove_const_t<Validator>;
 
-                x -= std::floor(x);
-                y -= std::floor(y);
-                z -= std::floor(z);
+        static inline const Validator& get(const std::reference_wrapper<Validator>& validator) noexcept {
+            return validator.get();
+        }
+    };
 
-                const double u = this->fade(x);
-                const double v = this->fade(y);
-                const double w = this->fade(z);
 
-                const std::int32_t A = this->p[X] + Y, AA = this->p[A] + Z, AB = this->p[A + 1] + Z;
-                const std::int32_t B = this->p[X + 1] + Y, BA = this->p[B] + Z, BB = this->p[B + 1] + Z;
+    // A* over a MAP_SIZE_X by MAP_SIZE_Y grid. Validator is any callable
+    // taking a Vector2i& and returning whether the tile can be entered, it
+    // is called through a const reference. Lambdas and functors inline into
+    // the search loop, A_Star keeps the std::function interface.
+    // TileCost weights each step by the tile it enters, see UniformCost.
+    // Jump point search is only used with uniform costs
+    template<typename Validator, typename TileCost = UniformCost>
+    class Basic_A_Star {
 
-                return this->lerp(
-                    w, 
+        using tile_cost_type = typename validator_traits<TileCost>::type;
+
+        public:
+
+            using cost_type = typename tile_cost_type::cost_type;
+
+        private:
+
+        static constexpr bool uniform_cost = tile_cost_type::uniform;
+
+        enum class node_state : uint8_t {
+            open,
+            closed,
+            none
+        };
+
+        // The search table keeps 6 bytes per tile, the position is implied by
+        // the row-major index:
+        //  - a uint32_t slot, the node's open list position while it is open
+        //    and the number of tiles back to its parent once it is closed
+        //  - a uint16_t meta, see below
+        // g and h only live in the open list entries, closed nodes don't need them
+        struct Meta {
+            // direction of the step from the parent, in DIRECTIONS order
+            static constexpr uint16_t DIRECTION = 0x0007;
+            static constexpr uint16_t CLOSED = 0x0008;
+            // search that last touched the node, older nodes read as none.
+            // 12 bits, so the table is wiped once every 4095 searches
+            static constexpr uint16_t GENERATION_SHIFT = 4;
+            static constexpr uint16_t MAX_GENERATION = 0x0FFF;
+        };
+
+        // N, E, S, W, NE, SE, NW, SW, the order of directions
+        static constexpr std::array<int8_t, 8> DIRECTION_X {0, 1, 0, -1, 1, 1, -1, -1};
+        static constexpr std::array<int8_t, 8> DIRECTION_Y {-1, 0, 1, 0, -1, 1, -1, 1};
+
+        struct OpenEntry {
+            cost_type g;
+            cost_type h;
+            uint32_t index;
+            // tiles back to the parent, more than one for jump points
+            uint32_t jump;
+
+            [[nodiscard]]
+            inline cost_type get_f() const noexcept {
+                return this->g + this->h;
+            }
+        };
+
+        // Orders the open list by f, ties go to the node closer to the target
+        // and then to the position, so expansion order never depends on push order
+        struct NodeLess {
+            inline bool operator()(const OpenEntry& a, const OpenEntry& b) const noexcept {
+                if (a.get_f() != b.get_f()) {
+                    return a.get_f() < b.get_f();
+                }
+                if (a.h != b.h) {
+                    return a.h < b.h;
+                }
+                return a.index < b.index;
+            }
+        };
+
+        struct NodeHandle {
+            vector<uint32_t>* slots;
+
+            inline uint32_t& operator()(const OpenEntry& entry) const noexcept {
+                return (*this->slots)[entry.index];
+            }
+        };
+
+        using OpenList = IndexedHeap<OpenEntry, NodeLess, NodeHandle>;
+
+        public:
+
+            enum class search_status {
+                in_progress,
+                done,
+                failed
+            };
+
+#ifdef BOAR_PATHFINDING_STATS
+            // Per query counters, only compiled in with BOAR_PATHFINDING_STATS
+            struct SearchStats {
+                uint64_t expanded = 0;
+                uint64_t pushed = 0;
+                // decrease-key operations, open nodes given a cheaper path.
+                // Closed nodes are never re-opened
+                uint64_t decreased = 0;
+                uint64_t validator_calls = 0;
+                std::size_t peak_open = 0;
+                std::chrono::nanoseconds time {0};
+            };
+#endif
+
+        private:
+
+        // Everything a search writes to, searches that use different
+        // workspaces can run at the same time on one A_Star
+        class Workspace {
+
+            public:
+
+                vector<uint32_t> slots;
+                vector<uint16_t> meta;
+                uint16_t generation = 0;
+
+                Vector2ui target {0, 0};
+                uint32_t start_index = 0;
+                OpenList open_list;
+
+                search_status status = search_status::failed;
+                // node the finished search ended on, the meeting node of a
+                // bidirectional search
+                uint32_t found = 0;
+
+                // backward half of a bidirectional search, made on first use,
+                // both halves keep the g of their closed nodes
+                bool bidirectional = false;
+                std::unique_ptr<Workspace> reverse;
+                vector<cost_type> closed_g;
+
+#ifdef BOAR_PATHFINDING_STATS
+                SearchStats stats;
+#endif
+
+                Workspace(std::size_t size)
+                : slots(size), meta(size), open_list{NodeLess{}, NodeHandle{&slots}} {}
+
+                Workspace(const Workspace&) = delete;
+                Workspace& operator=(const Workspace&) = delete;
+        };
+
+        private:
+
+            uint8_t ORTHOGONAL_COST = 10;
+            uint8_t DIAGONAL_COST   = 14;
+            
+            bool diagonal_move;
+            vector<Vector2i> directions;
+
+            const uint32_t MAP_SIZE_X;
+            const uint32_t MAP_SIZE_Y;
+
+            bool at_side;
+            bool add_target_to_result;
+
+            bool jump_point_search = false;
+            bool bidirectional = false;
+
+            const Validator extern_validade_tile;
+            const TileCost tile_cost;
+
+            static constexpr bool uses_passability_grid =
+                std::is_same_v<typename validator_traits<Validator>::type, PassabilityGrid>;
+
+            std::unique_ptr<Workspace> workspace;
+            vector<std::unique_ptr<Workspace>> worker_workspaces;
+
+            // workspaces of finished Search handles, reused by the next ones
+            vector<std::unique_ptr<Workspace>> spare_workspaces;
+            std::size_t search_workspaces = 0;
+
+            PathCache* cache = nullptr;
+
+
+        public:
+
+            Basic_A_Star (bool diagonal_move, uint32_t map_size_x, uint32_t map_size_y,
+                          Validator extern_validade_tile, TileCost tile_cost = TileCost())
+            : diagonal_move(diagonal_move), MAP_SIZE_X(map_size_x), 
+              MAP_SIZE_Y(map_size_y), extern_validade_tile(extern_validade_tile),
+              tile_cost(std::move(tile_cost)) {
+
+                  this->at_side = false;
+                  this->add_target_to_result = false;
+
+                this->directions.push_back({0, -1});
+                this->directions.push_back({1, 0});
+                this->directions.push_back({0, 1});
+                this->directions.push_back({-1, 0});
+
+                if (this->diagonal_move) {
+                    this->directions.push_back({1, -1});
+                    this->directions.push_back({1, 1});
+                    this->directions.push_back({-1, -1});
+                    this->directions.push_back({-1, 1});
+                }
+
+                this->workspace = std::make_unique<Workspace>(this->map_area());
+            }
+
+            void set_at_side(bool at_side, bool add_target_to_result) noexcept {
+                this->at_side = at_side;
+                this->add_target_to_result = add_target_to_result;
+            }
+
+            // Jump Point Search skips the symmetric paths of open terrain, it
+            // assumes every valid tile costs the same to enter
+            void set_jump_point_search(bool jump_point_search) noexcept {
+                this->jump_point_search = jump_point_search && uniform_cost;
+            }
+
+            // Searches from the start and the target at once. It pays off when
+            // the target is walled into a small or closed region, the target's
+            // side runs out early instead of the start's side flooding the map
+            // (about 35x fewer expansions in a 512x512 test). On open maps and
+            // mazes it expands slightly more than one way A*, 5-25%. It is not
+            // used together with at_side or jump point search, nor by stepped
+            // searches
+            void set_bidirectional(bool bidirectional) noexcept {
+                this->bidirectional = bidirectional;
+            }
+
+            // Answers find() from the cache before searching, nullptr turns it off.
+            // The cache must outlive the A_Star or be unset first
+            void set_cache(PathCache* cache) noexcept {
+                this->cache = cache;
+            }
+
+            std::optional<vector<Vector2ui>> find(Vector2ui start, Vector2ui target) {
+                return this->cached_run(*this->workspace, start, target);
+            }
+
+            // Like find(), but writes the path into path and reuses its storage
+            bool find(Vector2ui start, Vector2ui target, vector<Vector2ui>& path) {
+
+                if (this->cache) {
+                    const std::optional<vector<Vector2ui>> result = this->cached_run(*this->workspace, start, target);
+                    if (result) {
+                        path.assign(result->begin(), result->end());
+                    }
+                    return result.has_value();
+                }
+
+                if (!this->search(*this->workspace, start, target)) {
+                    return false;
+                }
+                path.resize(this->path_size(*this->workspace), Vector2ui{0, 0});
+                this->write_path(*this->workspace, path.data());
+                return true;
+            }
+
+            // Like find(), but writes the path into buffer. Returns the path's
+            // length, the path is only written when that is not above capacity
+            std::optional<std::size_t> find(Vector2ui start, Vector2ui target, Vector2ui* buffer, std::size_t capacity) {
+
+                if (this->cache) {
+                    const std::optional<vector<Vector2ui>> result = this->cached_run(*this->workspace, start, target);
+                    if (!result) {
+                        return {};
+                    }
+                    if (result->size() <= capacity) {
+                        std::copy(result->begin(), result->end(), buffer);
+                    }
+                    return {result->size()};
+                }
+
+                if (!this->search(*this->workspace, start, target)) {
+                    return {};
+                }
+                const std::size_t size = this->path_size(*this->workspace);
+                if (size <= capacity) {
+                    this->write_path(*this->workspace, buffer);
+                }
+                return {size};
+            }
+
+#ifdef BOAR_PATHFINDING_STATS
+            // Counters of the last find(), left untouched by cache hits
+            [[nodiscard]]
+            inline const SearchStats& last_stats() const noexcept {
+                return this->workspace->stats;
+            }
+#endif
+
+            // Solves every (start, target) pair on the pool's workers, results
+            // come back in request order. Each worker keeps its own workspace
+            // between batches, the map and the tile validator are shared, so
+            // extern_validade_tile must be safe to call from several threads
+            vector<std::optional<vector<Vector2ui>>> find_batch(const vector<std::pair<Vector2ui, Vector2ui>>& queries, ThreadPool& pool) {
+
+                while (this->worker_workspaces.size() < pool.size()) {
+                    this->worker_workspaces.push_back(std::make_unique<Workspace>(this->map_area()));
+                }
+
+                vector<std::optional<vector<Vector2ui>>> results(queries.size());
+                pool.parallel_for(queries.size(), [&](std::size_t i, std::size_t worker) {
+                    results[i] = this->cached_run(*this->worker_workspaces[worker], queries[i].first, queries[i].second);
+                });
+                return results;
+            }
+
+            // A find() that runs a bounded number of expansions at a time, so a
+            // long search can be spread over several frames. Each handle owns
+            // a workspace taken from its A_Star and gives it back when destroyed
+            // or assigned to, so it must not outlive the A_Star nor see it
+            // moved. A moved-from handle is empty: it reads as failed and
+            // step() does nothing
+            class Search {
+
+                friend class Basic_A_Star;
+
+                private:
+
+                    Basic_A_Star* owner;
+                    std::unique_ptr<Workspace> ws;
+
+                    Search(Basic_A_Star* owner, std::unique_ptr<Workspace> ws)
+                    : owner(owner), ws(std::move(ws)) {}
+
+                    // take_workspace() reserved room for every workspace it
+                    // handed out, so the push_back never allocates
+                    void release() noexcept {
+                        if (this->ws) {
+                            this->owner->spare_workspaces.push_back(std::move(this->ws));
+                        }
+                    }
+
+                public:
+
+                    Search(Search&&) = default;
+
+                    // Gives the current workspace back before taking other's
+                    Search& operator=(Search&& other) noexcept {
+                        if (this != &other) {
+                            this->release();
+                            this->owner = other.owner;
+                            this->ws = std::move(other.ws);
+                        }
+                        return *this;
+                    }
+
+                    ~Search() {
+                        this->release();
+                    }
+
+                    [[nodiscard]]
+                    inline search_status status() const noexcept {
+                        return this->ws ? this->ws->status : search_status::failed;
+                    }
+
+                    // Expands at most max_expansions nodes
+                    search_status step(uint64_t max_expansions) noexcept {
+                        if (!this->ws) {
+                            return search_status::failed;
+                        }
+                        return this->owner->expand(*this->ws, max_expansions);
+                    }
+
+                    // Expands nodes until budget runs out, the clock is read
+                    // every CLOCK_INTERVAL expansions
+                    search_status step_for(std::chrono::nanoseconds budget) noexcept {
+
+                        constexpr uint64_t CLOCK_INTERVAL = 64;
+                        const auto deadline = std::chrono::steady_clock::now() + budget;
+                        while (this->step(CLOCK_INTERVAL) == search_status::in_progress &&
+                               std::chrono::steady_clock::now() < deadline) {}
+                        return this->status();
+                    }
+
+#ifdef BOAR_PATHFINDING_STATS
+                    // Must not be called on an empty handle
+                    [[nodiscard]]
+                    inline const SearchStats& stats() const noexcept {
+                        return this->ws->stats;
+                    }
+#endif
+
+                    // The path once the search is done
+                    [[nodiscard]]
+                    std::optional<vector<Vector2ui>> result() const {
+                        if (this->status() != search_status::done) {
+                            return {};
+                        }
+                        vector<Vector2ui> path(this->owner->path_size(*this->ws), Vector2ui{0, 0});
+                        this->owner->write_path(*this->ws, path.data());
+                        return {path};
+                    }
+            };
+
+            // Round-robin over several searches, every in-progress search gets
+            // the same share of each frame's budget and the search served first
+            // rotates between frames. Finished searches are dropped. It keeps
+            // pointers to the searches, so a scheduled search must stay alive
+            // and in place: remove() it before moving or destroying it
+            class Scheduler {
+
+                private:
+
+                    vector<Search*> searches;
+                    std::size_t first = 0;
+
+                public:
+
+                    void add(Search& search) {
+                        this->searches.push_back(&search);
+                    }
+
+                    void remove(Search& search) noexcept {
+                        this->searches.erase(std::remove(this->searches.begin(), this->searches.end(), &search), this->searches.end());
+                    }
+
+                    [[nodiscard]]
+                    inline std::size_t size() const noexcept {
+                        return this->searches.size();
+                    }
+
+                    // Shares max_expansions between the searches
+                    void run(uint64_t max_expansions) noexcept {
+                        this->serve([max_expansions](Search& search, std::size_t count) {
+                            search.step(std::max<uint64_t>(1, max_expansions / count));
+                        });
+                    }
+
+                    // Shares a time budget between the searches
+                    void run_for(std::chrono::nanoseconds budget) noexcept {
+                        this->serve([budget](Search& search, std::size_t count) {
+                            search.step_for(budget / count);
+                        });
+                    }
+
+                private:
+
+                    template<typename Step>
+                    void serve(Step step) noexcept {
+
+                        const std::size_t count = this->searches.size();
+                        for (std::size_t i = 0; i < count; i++) {
+                            Search& search = *this->searches[(this->first + i) % count];
+                            if (search.status() == search_status::in_progress) {
+                                step(search, count);
+                            }
+                        }
+                        if (count > 0) {
+                            this->first = (this->first + 1) % count;
+                        }
+
+                        this->searches.erase(std::remove_if(this->searches.begin(), this->searches.end(), [](Search* i) {
+                            return i->status() != search_status::in_progress;
+                        }), this->searches.end());
+                    }
+            };
+
+            // Starts a search that runs only when stepped
+            Search start_search(Vector2ui start, Vector2ui target) {
+
+                Search search(this, this->take_workspace());
+                this->begin(*search.ws, start, target);
+                return search;
+            }
+
+        private:
+
+            std::optional<vector<Vector2ui>> cached_run(Workspace& ws, const Vector2ui& start, const Vector2ui& target) const {
+
+                if (!this->cache) {
+                    return this->run(ws, start, target);
+                }
+
+                const PathCache::Config config = this->cache_config();
+                std::optional<vector<Vector2ui>> result = this->cache->lookup(start, target, config);
+                if (!result) {
+                    result = this->run(ws, start, target);
+                    if (result) {
+                        this->cache->store(start, target, config, *result);
+                    }
+                }
+                return result;
+            }
+
+            // Weighted searches are told apart by the address of their cost
+            // policy, so A_Stars sharing one CostGrid through std::cref share paths
+            [[nodiscard]]
+            PathCache::Config cache_config() const noexcept {
+
+                PathCache::Config config;
+                config.diagonal_move = this->diagonal_move;
+                config.at_side = this->at_side;
+                config.add_target_to_result = this->add_target_to_result;
+                config.jump_point_search = this->jump_point_search;
+                config.bidirectional = this->bidirectional;
+                if constexpr (!uniform_cost) {
+                    config.tile_cost = &validator_traits<TileCost>::get(this->tile_cost);
+                }
+                return config;
+            }
+
+            std::optional<vector<Vector2ui>> run(Workspace& ws, const Vector2ui& start, const Vector2ui& target) const {
+
+                if (!this->search(ws, start, target)) {
+                    return {};
+                }
+                vector<Vector2ui> path(this->path_size(ws), Vector2ui{0, 0});
+                this->write_path(ws, path.data());
+                return {path};
+            }
+
+            // Runs a whole query in ws, the path is then read with path_size()
+            // and write_path()
+            bool search(Workspace& ws, const Vector2ui& start, const Vector2ui& target) const noexcept {
+
+                if (this->bidirectional && !this->at_side && !this->jump_point_search && start != target) {
+                    return this->run_bidirectional(ws, start, target);
+                }
+                this->begin(ws, start, target);
+                return this->expand(ws, UINT64_MAX) == search_status::done;
+            }
+
+            void begin(Workspace& ws, const Vector2ui& start, const Vector2ui& target) const noexcept {
+
+                ws.target = target;
+                ws.bidirectional = false;
+                ws.status = search_status::failed;
+
+#ifdef BOAR_PATHFINDING_STATS
+                ws.stats = SearchStats();
+                const auto begin_time = std::chrono::steady_clock::now();
+                const uint64_t begin_calls = validator_calls;
+                struct Finish {
+                    Workspace& ws;
+                    std::chrono::steady_clock::time_point time;
+                    uint64_t calls;
+                    ~Finish() {
+                        this->ws.stats.time += std::chrono::steady_clock::now() - this->time;
+                        this->ws.stats.validator_calls += validator_calls - this->calls;
+                    }
+                } finish {ws, begin_time, begin_calls};
+#endif
+
+                {
+                    uint8_t i = 0;
+                    for (; i < this->directions.size(); i ++) {
+                        if (this->validate_neighbor((Vector2i)target + this->directions[i])) {
+                            break;
+                        }
+                    }
+                    if (i == this->directions.size()){
+                        return;
+                    }
+                }
+
+                this->next_generation(ws);
+
+                ws.open_list.clear();
+
+                ws.start_index = this->index_of(start);
+                this->claim_node(ws, ws.start_index, 0);
+                ws.open_list.push({0, this->calculate_h(start, target), ws.start_index, 0});
+
+#ifdef BOAR_PATHFINDING_STATS
+                ws.stats.pushed = 1;
+                ws.stats.peak_open = 1;
+#endif
+
+                ws.status = search_status::in_progress;
+            }
+
+            // Expands up to max_expansions nodes of the search in ws
+            search_status expand(Workspace& ws, uint64_t max_expansions) const noexcept {
+
+                OpenList& open_list = ws.open_list;
+                const Vector2ui& target = ws.target;
+                const uint32_t start_index = ws.start_index;
+
+#ifdef BOAR_PATHFINDING_STATS
+                const auto begin_time = std::chrono::steady_clock::now();
+                const uint64_t begin_calls = validator_calls;
+#endif
+
+                for (; ws.status == search_status::in_progress && max_expansions > 0; max_expansions--) {
+
+                    if (open_list.empty()) {
+                        ws.status = search_status::failed;
+                        break;
+                    }
+
+#ifdef BOAR_PATHFINDING_STATS
+                    ws.stats.peak_open = std::max(ws.stats.peak_open, open_list.size());
+                    ws.stats.expanded++;
+#endif
+
+                    const OpenEntry current = open_list.pop();
+                    const uint32_t current_index = current.index;
+                    ws.slots[current_index] = current.jump;
+                    ws.meta[current_index] |= Meta::CLOSED;
+
+                    const Vector2ui current_pos = this->pos_of(current_index);
+
+                    if (current_pos == target || (this->at_side && this->is_beside_target(current_pos, target))) {
+                        ws.found = current_index;
+                        ws.status = search_status::done;
+                        break;
+                    }
+
+                    if (this->jump_point_search) {
+                        this->push_jump_points(ws, current, current_pos, start_index);
+                        continue;
+                    }
+
+                    Vector2i poss_neighbor_pos {0, 0};
+
+                    if constexpr (uses_passability_grid) {
+
+                        const uint8_t mask = validator_traits<Validator>::get(this->extern_validade_tile)
+                            .neighbor_mask(current_pos.x, current_pos.y);
+
+                        for (uint8_t i = 0; i < this->directions.size(); i++) {
+                            if (mask & (1 << i)) {
+                                poss_neighbor_pos = current_pos + this->directions[i];
+                                this->relax(ws, current, poss_neighbor_pos, i, 1, this->step_cost(this->directions[i]), poss_neighbor_pos);
+                            }
+                        }
+                        continue;
+                    }
+
+                    for (uint8_t i = 0; i < this->directions.size(); i++) {
+                        
+                        poss_neighbor_pos = current_pos + this->directions[i];
+
+                        if (!this->validate_neighbor(poss_neighbor_pos)) {
+                            continue;
+                        }
+
+                        this->relax(ws, current, poss_neighbor_pos, i, 1, this->step_cost(this->directions[i]), poss_neighbor_pos);
+                    }
+                }
+
+#ifdef BOAR_PATHFINDING_STATS
+                ws.stats.time += std::chrono::steady_clock::now() - begin_time;
+                ws.stats.validator_calls += validator_calls - begin_calls;
+#endif
+
+                return ws.status;
+            }
+
+            std::unique_ptr<Workspace> take_workspace() {
+
+                if (this->spare_workspaces.empty()) {
+                    // room for all of them to come back, see Search::release()
+                    this->search_workspaces++;
+                    this->spare_workspaces.reserve(this->search_workspaces);
+                    return std::make_unique<Workspace>(this->map_area());
+                }
+                std::unique_ptr<Workspace> ws = std::move(this->spare_workspaces.back());
+                this->spare_workspaces.pop_back();
+                return ws;
+            }
+
+            [[nodiscard]]
+            inline std::size_t map_area() const noexcept {
+                return static_cast<std::size_t>(this->MAP_SIZE_X) * this->MAP_SIZE_Y;
+            }
+
+            [[nodiscard]]
+            inline uint32_t index_of(const Vector2ui& pos) const noexcept {
+                return pos.y * this->MAP_SIZE_X + pos.x;
+            }
+
+            [[nodiscard]]
+            inline Vector2ui pos_of(uint32_t index) const noexcept {
+                return {index % this->MAP_SIZE_X, index / this->MAP_SIZE_X};
+            }
+
+            // Starts a new search, every node of an older search reads as none.
+            // The table is only wiped when the generation wraps, which spreads
+            // the clearing over 4095 searches (about 8 KB a search on a 4096
+            // by 4096 map)
+            static inline void next_generation(Workspace& ws) noexcept {
+                ws.generation++;
+                if (ws.generation > Meta::MAX_GENERATION) {
+                    std::fill(ws.meta.begin(), ws.meta.end(), 0);
+                    ws.generation = 1;
+                }
+            }
+
+            [[nodiscard]]
+            static inline node_state state_of(const Workspace& ws, uint32_t index) noexcept {
+                const uint16_t meta = ws.meta[index];
+                if (meta >> Meta::GENERATION_SHIFT != ws.generation) {
+                    return node_state::none;
+                }
+                return meta & Meta::CLOSED ? node_state::closed : node_state::open;
+            }
+
+            // Offers the node at pos a path through current that costs mov_cost
+            // more, dir is the step's index in DIRECTIONS and jump its length.
+            // The tile cost is the one of entered, pos itself unless searching backwards
+            inline void relax(Workspace& ws, const OpenEntry& current, const Vector2ui& pos, uint8_t dir,
+                              uint32_t jump, cost_type mov_cost, const Vector2ui& entered) const noexcept {
+
+                const uint32_t neighbor_index = this->index_of(pos);
+                const node_state neighbor_state = this->state_of(ws, neighbor_index);
+
+                if (neighbor_state == node_state::closed) {
+                    return;
+                }
+
+                if constexpr (!uniform_cost) {
+                    mov_cost *= validator_traits<TileCost>::get(this->tile_cost)(entered);
+                }
+
+                if (neighbor_state == node_state::open) {
+
+                    OpenEntry& neighbor = ws.open_list.at(ws.slots[neighbor_index]);
+
+                    const cost_type better_g = static_cast<cost_type>(current.g + mov_cost);
+                    if (better_g < neighbor.g) {
+                        ws.meta[neighbor_index] = static_cast<uint16_t>((ws.meta[neighbor_index] & ~Meta::DIRECTION) | dir);
+                        neighbor.g = better_g;
+                        neighbor.jump = jump;
+                        if (ws.bidirectional) {
+                            neighbor.h = std::max(this->calculate_h(pos, ws.target), better_g);
+                        }
+                        ws.open_list.decrease(neighbor);
+#ifdef BOAR_PATHFINDING_STATS
+                        ws.stats.decreased++;
+#endif
+                    }
+                }
+
+                else {
+
+                    const cost_type g = static_cast<cost_type>(current.g + mov_cost);
+                    cost_type h = this->calculate_h(pos, ws.target);
+                    if (ws.bidirectional) {
+                        h = std::max(h, g);
+                    }
+
+                    this->claim_node(ws, neighbor_index, dir);
+                    ws.open_list.push({g, h, neighbor_index, jump});
+#ifdef BOAR_PATHFINDING_STATS
+                    ws.stats.pushed++;
+#endif
+                }
+            }
+
+            // ############################################################################
+            // #                                                                          #
+            // #                             bidirectional                                #
+            // #                                                                          #
+            // ############################################################################
+
+            // Searches forward in ws and backward from the target in ws.reverse,
+            // meeting in the middle (Holte et al.'s MM): both sides order their
+            // open lists by max(f, 2g), stored as h = max(h, g), so neither goes
+            // much past half the path's cost, and the side with the smaller
+            // top is expanded. mu is the cheapest path seen where the two
+            // sides touch, no path through the open lists beats it once it
+            // is not above the smaller top. That stop rule needs h to be
+            // admissible both ways, which the octile and manhattan distances
+            // scaled by the cheapest step are
+            bool run_bidirectional(Workspace& ws, const Vector2ui& start, const Vector2ui& target) const noexcept {
+
+#ifdef BOAR_PATHFINDING_STATS
+                const auto begin_time = std::chrono::steady_clock::now();
+                const uint64_t begin_calls = validator_calls;
+#endif
+
+                if (!ws.reverse) {
+                    ws.reverse = std::make_unique<Workspace>(this->map_area());
+                }
+                Workspace& rev = *ws.reverse;
+
+                this->begin(ws, start, target);
+                this->begin(rev, target, start);
+                ws.closed_g.resize(this->map_area());
+                rev.closed_g.resize(this->map_area());
+                ws.bidirectional = true;
+                rev.bidirectional = true;
+
+                // the forward search never enters an invalid target
+                if (ws.status != search_status::in_progress || rev.status != search_status::in_progress ||
+                    !this->validate_neighbor(target)) {
+                    ws.status = search_status::failed;
+                    return false;
+                }
+
+                std::optional<cost_type> mu;
+
+                while (!ws.open_list.empty() && !rev.open_list.empty()) {
+
+                    const cost_type forward_top = ws.open_list.top().get_f();
+                    const cost_type backward_top = rev.open_list.top().get_f();
+
+                    if (mu && *mu <= std::min(forward_top, backward_top)) {
+                        break;
+                    }
+
+                    const bool forward = forward_top < backward_top ||
+                        (forward_top == backward_top && ws.open_list.size() <= rev.open_list.size());
+                    Workspace& side = forward ? ws : rev;
+                    Workspace& other = forward ? rev : ws;
+
+#ifdef BOAR_PATHFINDING_STATS
+                    side.stats.peak_open = std::max(side.stats.peak_open, side.open_list.size());
+                    side.stats.expanded++;
+#endif
+
+                    const OpenEntry current = side.open_list.pop();
+                    side.slots[current.index] = current.jump;
+                    side.meta[current.index] |= Meta::CLOSED;
+                    side.closed_g[current.index] = current.g;
+
+                    const Vector2ui current_pos = this->pos_of(current.index);
+
+                    uint8_t mask = this->neighbor_mask(current_pos);
+                    // the start tile is never validated, the backward side
+                    // may step onto it anyway
+                    if (!forward && this->distance(current_pos, start) == 1) {
+                        mask |= static_cast<uint8_t>(1 << this->direction_code((Vector2i)start - current_pos));
+                    }
+
+                    for (uint8_t i = 0; i < this->directions.size(); i++) {
+
+                        if (!(mask & (1 << i))) {
+                            continue;
+                        }
+                        const Vector2i next = current_pos + this->directions[i];
+
+                        // a backward step pays for the tile it leaves
+                        this->relax(side, current, next, i, 1, this->step_cost(this->directions[i]), forward ? (Vector2ui)next : current_pos);
+
+                        const uint32_t next_index = this->index_of(next);
+                        const std::optional<cost_type> here = this->g_of(side, next_index);
+                        const std::optional<cost_type> there = this->g_of(other, next_index);
+                        if (here && there && (!mu || *here + *there < *mu)) {
+                            mu = *here + *there;
+                            ws.found = next_index;
+                        }
+                    }
+                }
+
+                ws.status = mu ? search_status::done : search_status::failed;
+
+#ifdef BOAR_PATHFINDING_STATS
+                ws.stats.expanded += rev.stats.expanded;
+                ws.stats.pushed += rev.stats.pushed;
+                ws.stats.decreased += rev.stats.decreased;
+                ws.stats.peak_open = std::max(ws.stats.peak_open, rev.stats.peak_open);
+                ws.stats.time = std::chrono::steady_clock::now() - begin_time;
+                ws.stats.validator_calls = validator_calls - begin_calls;
+#endif
+
+                return mu.has_value();
+            }
+
+            // g of a node reached by a bidirectional search half
+            [[nodiscard]]
+            static inline std::optional<cost_type> g_of(const Workspace& ws, uint32_t index) noexcept {
+
+                switch (state_of(ws, index)) {
+                    case node_state::open:
+                        return {ws.open_list.data()[ws.slots[index]].g};
+                    case node_state::closed:
+                        return {ws.closed_g[index]};
+                    default:
+                        return {};
+                }
+            }
+
+            // ############################################################################
+            // #                                                                          #
+            // #                                 paths                                    #
+            // #                                                                          #
+            // ############################################################################
+
+            // Length of the path of a finished search
+            [[nodiscard]]
+            std::size_t path_size(const Workspace& ws) const noexcept {
+
+                std::size_t size = this->chain_length(ws, ws.found);
+                if (ws.bidirectional) {
+                    size += this->chain_length(*ws.reverse, ws.found);
+                }
+                else if (ws.found != this->index_of(ws.target) && this->add_target_to_result) {
+                    size++;
+                }
+                return size;
+            }
+
+            // Writes the path of a finished search to out, which must have
+            // room for path_size() tiles
+            void write_path(const Workspace& ws, Vector2ui* out) const noexcept {
+
+                // forward chain, root to found, written back to front
+                const std::size_t length = this->chain_length(ws, ws.found);
+                Vector2ui* back = out + length;
+                for (uint32_t i = ws.found; i != ws.start_index; i = this->parent_of(ws, i)) {
+
+                    const Vector2i dir = this->direction_of(ws, i);
+
+                    Vector2i pos = this->pos_of(i);
+                    for (uint32_t step = this->jump_of(ws, i); step > 0; step--) {
+                        *--back = pos;
+                        pos = pos - dir;
+                    }
+                }
+                out += length;
+
+                if (ws.bidirectional) {
+                    // backward chain, found to the target, already in walking order
+                    const Workspace& rev = *ws.reverse;
+                    for (uint32_t i = ws.found; i != rev.start_index; i = this->parent_of(rev, i)) {
+
+                        const Vector2i dir = this->direction_of(rev, i);
+
+                        Vector2i pos = this->pos_of(i);
+                        for (uint32_t step = this->jump_of(rev, i); step > 0; step--) {
+                            pos = pos - dir;
+                            *out++ = pos;
+                        }
+                    }
+                }
+                else if (ws.found != this->index_of(ws.target) && this->add_target_to_result) {
+                    *out = ws.target;
+                }
+            }
+
+            // Tiles from the root to the closed node curr
+            [[nodiscard]]
+            inline std::size_t chain_length(const Workspace& ws, uint32_t curr) const noexcept {
+
+                std::size_t length = 0;
+                for (uint32_t i = curr; i != ws.start_index; i = this->parent_of(ws, i)) {
+                    length += this->jump_of(ws, i);
+                }
+                return length;
+            }
+
+            // Tiles back to the node's parent, only the meeting node of a
+            // bidirectional search can still be open
+            [[nodiscard]]
+            static inline uint32_t jump_of(const Workspace& ws, uint32_t index) noexcept {
+                if (state_of(ws, index) == node_state::open) {
+                    return ws.open_list.data()[ws.slots[index]].jump;
+                }
+                return ws.slots[index];
+            }
+
+            // Step from the closed node's parent to it
+            [[nodiscard]]
+            static inline Vector2i direction_of(const Workspace& ws, uint32_t index) noexcept {
+                const uint8_t dir = static_cast<uint8_t>(ws.meta[index] & Meta::DIRECTION);
+                return {DIRECTION_X[dir], DIRECTION_Y[dir]};
+            }
+
+            [[nodiscard]]
+            inline uint32_t parent_of(const Workspace& ws, uint32_t index) const noexcept {
+                const Vector2i dir = this->direction_of(ws, index);
+                const int32_t jump = static_cast<int32_t>(this->jump_of(ws, index));
+                // unsigned wrap-around gives the right index for negative offsets
+                return index - static_cast<uint32_t>((dir.y * static_cast<int32_t>(this->MAP_SIZE_X) + dir.x) * jump);
+            }
+
+            // Index of the unit step dir in DIRECTIONS
+            [[nodiscard]]
+            static inline uint8_t direction_code(const Vector2i& dir) noexcept {
+                for (uint8_t i = 0; i < DIRECTION_X.size(); i++) {
+                    if (DIRECTION_X[i] == dir.x && DIRECTION_Y[i] == dir.y) {
+                        return i;
+                    }
+                }
+                return 0;
+            }
+
+            [[nodiscard]]
+            inline bool is_beside_target(const Vector2ui& pos, const Vector2ui& target) const noexcept {
+
+                for (const auto& i: this->directions) {
+                    if (pos + i == target) {
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            [[nodiscard]]
+            static inline uint32_t distance(const Vector2i& a, const Vector2i& b) noexcept {
+                return std::max(std::abs(a.x - b.x), std::abs(a.y - b.y));
+            }
+
+            // ############################################################################
+            // #                                                                          #
+            // #                           jump point search                              #
+            // #                                                                          #
+            // ############################################################################
+
+            // Harabor & Grastien's pruning rules, following the existing movement
+            // model: diagonal steps only need the destination tile to be valid
+
+            [[nodiscard]]
+            inline bool walkable(int32_t x, int32_t y) const noexcept {
+                return this->validate_neighbor({x, y});
+            }
+
+            [[nodiscard]]
+            inline bool is_jump_goal(const Vector2i& pos, const Vector2ui& target) const noexcept {
+                return pos == (Vector2i)target || (this->at_side && this->is_beside_target(pos, target));
+            }
+
+            void push_jump_points(Workspace& ws, const OpenEntry& current, const Vector2ui& current_pos, uint32_t root) const noexcept {
+
+                std::array<Vector2i, 8> dirs {Vector2i{0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}};
+                uint8_t count = 0;
+
+                const int32_t x = current_pos.x;
+                const int32_t y = current_pos.y;
+
+                if (current.index == root) {
+                    for (const auto& i: this->directions) {
+                        dirs[count++] = i;
+                    }
+                }
+                else {
+                    const Vector2i d = this->direction_of(ws, current.index);
+
+                    if (d.x != 0 && d.y != 0) {
+                        dirs[count++] = {0, d.y};
+                        dirs[count++] = {d.x, 0};
+                        dirs[count++] = d;
+                        if (!this->walkable(x - d.x, y)) {
+                            dirs[count++] = {-d.x, d.y};
+                        }
+                        if (!this->walkable(x, y - d.y)) {
+                            dirs[count++] = {d.x, -d.y};
+                        }
+                    }
+                    else if (this->diagonal_move) {
+                        dirs[count++] = d;
+                        if (d.x != 0) {
+                            if (!this->walkable(x, y + 1)) dirs[count++] = {d.x, 1};
+                            if (!this->walkable(x, y - 1)) dirs[count++] = {d.x, -1};
+                        }
+                        else {
+                            if (!this->walkable(x + 1, y)) dirs[count++] = {1, d.y};
+                            if (!this->walkable(x - 1, y)) dirs[count++] = {-1, d.y};
+                        }
+                    }
+                    else {
+                        dirs[count++] = d;
+                        if (d.x != 0) {
+                            dirs[count++] = {0, -1};
+                            dirs[count++] = {0, 1};
+                        }
+                        else {
+                            dirs[count++] = {-1, 0};
+                            dirs[count++] = {1, 0};
+                        }
+                    }
+                }
+
+                for (uint8_t i = 0; i < count; i++) {
+                    const std::optional<Vector2i> jump_point = this->jump(current_pos, dirs[i], ws.target);
+                    if (jump_point) {
+                        const uint32_t jump = this->distance(current_pos, *jump_point);
+                        this->relax(ws, current, *jump_point, this->direction_code(dirs[i]), jump, jump * this->step_cost(dirs[i]), *jump_point);
+                    }
+                }
+            }
+
+            // Walks from pos in dir until it reaches a jump point, returns nothing
+            // if the walk runs into an invalid tile first
+            std::optional<Vector2i> jump(Vector2i pos, const Vector2i& dir, const Vector2ui& target) const noexcept {
+
+                while (true) {
+
+                    pos = pos + dir;
+                    const int32_t x = pos.x;
+                    const int32_t y = pos.y;
+
+                    if (!this->walkable(x, y)) {
+                        return {};
+                    }
+                    if (this->is_jump_goal(pos, target)) {
+                        return pos;
+                    }
+
+                    if (dir.x != 0 && dir.y != 0) {
+                        if ((this->walkable(x - dir.x, y + dir.y) && !this->walkable(x - dir.x, y)) ||
+                            (this->walkable(x + dir.x, y - dir.y) && !this->walkable(x, y - dir.y))) {
+                            return pos;
+                        }
+                        if (this->jump(pos, {dir.x, 0}, target) || this->jump(pos, {0, dir.y}, target)) {
+                            return pos;
+                        }
+                    }
+                    else if (this->diagonal_move) {
+                        if (dir.x != 0) {
+                            if ((this->walkable(x + dir.x, y + 1) && !this->walkable(x, y + 1)) ||
+                                (this->walkable(x + dir.x, y - 1) && !this->walkable(x, y - 1))) {
+                                return pos;
+                            }
+                        }
+                        else {
+                            if ((this->walkable(x + 1, y + dir.y) && !this->walkable(x + 1, y)) ||
+                                (this->walkable(x - 1, y + dir.y) && !this->walkable(x - 1, y))) {
+                                return pos;
+                            }
+                        }
+                    }
+                    else {
+                        if (dir.x != 0) {
+                            if ((this->walkable(x, y - 1) && !this->walkable(x - dir.x, y - 1)) ||
+                                (this->walkable(x, y + 1) && !this->walkable(x - dir.x, y + 1))) {
+                                return pos;
+                            }
+                        }
+                        else {
+                            if ((this->walkable(x - 1, y) && !this->walkable(x - 1, y - dir.y)) ||
+                                (this->walkable(x + 1, y) && !this->walkable(x + 1, y - dir.y))) {
+                                return pos;
+                            }
+                            if (this->jump(pos, {1, 0}, target) || this->jump(pos, {-1, 0}, target)) {
+                                return pos;
+                            }
+                        }
+                    }
+                }
+            }
+
+            inline cost_type calculate_h(const Vector2ui& pos, const Vector2ui& target) const noexcept {
+
+                Vector2i delta {abs(static_cast<int32_t>(pos.x - target.x)), abs(static_cast<int32_t>(pos.y - target.y))};
+
+                cost_type h;
+                if (this->diagonal_move) {
+                    // octile, the cost of the cheapest move sequence. Euclidean
+                    // would overestimate every diagonal, 10 * sqrt(2) > 14
+                    const int32_t diagonal = std::min(delta.x, delta.y);
+                    h = static_cast<cost_type>(this->ORTHOGONAL_COST * (std::max(delta.x, delta.y) - diagonal) + this->DIAGONAL_COST * diagonal);
+                }
+                else {
+                    // manhattan
+                    h = (10 * (delta.x + delta.y));
+                }
+
+                if constexpr (!uniform_cost) {
+                    // no step is cheaper than its base cost times the cheapest tile
+                    h *= validator_traits<TileCost>::get(this->tile_cost).min_cost();
+                }
+                return h;
+            }
+
+            // Cost of one step in dir
+            [[nodiscard]]
+            inline uint8_t step_cost(const Vector2i& dir) const noexcept {
+
+                if (this->diagonal_move && (dir.x == 0 || dir.y == 0)) {
+                    return this->ORTHOGONAL_COST;
+                }
+                else {
+                    return this->DIAGONAL_COST;
+                }
+            }
+
+            // Valid neighbors of pos, bit i for DIRECTIONS[i], from a
+            // PassabilityGrid's word loads when there is one
+            [[nodiscard]]
+            inline uint8_t neighbor_mask(const Vector2ui& pos) const noexcept {
+
+                if constexpr (uses_passability_grid) {
+                    return validator_traits<Validator>::get(this->extern_validade_tile).neighbor_mask(pos.x, pos.y);
+                }
+                else {
+                    uint8_t mask = 0;
+                    for (uint8_t i = 0; i < this->directions.size(); i++) {
+                        if (this->validate_neighbor(pos + this->directions[i])) {
+                            mask |= static_cast<uint8_t>(1 << i);
+                        }
+                    }
+                    return mask;
+                }
+            }
+
+            // Claims the node for the current search as open, dir is the step
+            // from its parent
+            static inline void claim_node(Workspace& ws, uint32_t index, uint8_t dir) noexcept {
+                ws.meta[index] = static_cast<uint16_t>(ws.generation << Meta::GENERATION_SHIFT | dir);
+            }
+    
+            [[nodiscard]]
+            inline bool validate_neighbor(Vector2i pos) const noexcept {
+
+                if (pos.x < 0 || (uint32_t)pos.x == this->MAP_SIZE_X || pos.y < 0 || (uint32_t)pos.y == MAP_SIZE_Y) {
+                    return false;
+                }
+#ifdef BOAR_PATHFINDING_STATS
+                validator_calls++;
+#endif
+                return this->extern_validade_tile(pos);
+            }
+
+#ifdef BOAR_PATHFINDING_STATS
+            // validate_neighbor() has no workspace at hand, it counts per
+            // thread and the searches take the difference
+            static inline thread_local uint64_t validator_calls = 0;
+#endif
+    
+    };
+
+    using A_Star = Basic_A_Star<std::function<bool(Vector2i&)>>;
+
+
+    // Hierarchical A* (Botea, Mueller & Schaeffer) for very large maps. The
+    // map is cut into square clusters, entrances are placed on the borders
+    // between them and the costs between the entrances of each cluster are
+    // precomputed with a cluster sized A_Star. find() searches that abstract
+    // graph and then refines only the segments of the path it picked.
+    // Paths are close to optimal, not always optimal
+    template<typename Validator>
+    class Basic_HPA_Star {
+
+        static constexpr uint32_t NO_PATH = UINT32_MAX;
+
+        // A run of passable border pairs up to this long gets one entrance in
+        // its middle, longer runs get one at each end
+        static constexpr uint32_t MAX_SINGLE_ENTRANCE = 6;
+
+        // Sees the map only inside the cluster being searched, in cluster coordinates
+        struct ClusterValidator {
+            const Basic_HPA_Star* owner;
+
+            inline bool operator()(Vector2i& local) const noexcept {
+
+                if ((uint32_t)local.x >= this->owner->cluster_extent.x || (uint32_t)local.y >= this->owner->cluster_extent.y) {
+                    return false;
+                }
+                Vector2i pos {local.x + (int32_t)this->owner->cluster_origin.x, local.y + (int32_t)this->owner->cluster_origin.y};
+                return this->owner->extern_validade_tile(pos);
+            }
+        };
+
+        class Cluster {
+
+            public:
+
+                // tile indices of the entrances, sorted
+                vector<uint32_t> entrances;
+
+                // tiles in neighbor clusters each entrance leads to
+                vector<vector<uint32_t>> links;
+
+                // entrances.size() squared intra cluster costs, NO_PATH if unreachable
+                vector<uint32_t> costs;
+        };
+
+        class AbstractNode {
+
+            public:
+
+                uint32_t tile;
+                uint32_t g;
+                uint32_t h;
+                uint32_t parent;
+                uint32_t heap_index;
+                bool closed;
+
+                // first tile after the start when the start is not a valid
+                // tile and the path leaves its cluster right away
+                uint32_t via;
+
+                AbstractNode(uint32_t tile, uint32_t g, uint32_t h, uint32_t parent)
+                : tile(tile), g(g), h(h), parent(parent) {
+                    heap_index = 0;
+                    closed = false;
+                    via = NO_PATH;
+                }
+        };
+
+        struct AbstractLess {
+            const vector<AbstractNode>* nodes;
+
+            inline bool operator()(uint32_t a, uint32_t b) const noexcept {
+                const AbstractNode& node_a = (*this->nodes)[a];
+                const AbstractNode& node_b = (*this->nodes)[b];
+                if (node_a.g + node_a.h != node_b.g + node_b.h) {
+                    return node_a.g + node_a.h < node_b.g + node_b.h;
+                }
+                if (node_a.h != node_b.h) {
+                    return node_a.h < node_b.h;
+                }
+                return node_a.tile < node_b.tile;
+            }
+        };
+
+        struct AbstractHandle {
+            vector<AbstractNode>* nodes;
+
+            inline uint32_t& operator()(uint32_t node) const noexcept {
+                return (*this->nodes)[node].heap_index;
+            }
+        };
+
+        // ids of the query's own nodes, entrances get ids after them
+        static constexpr uint32_t START_NODE = 0;
+        static constexpr uint32_t GOAL_NODE = 1;
+
+        private:
+
+            bool diagonal_move;
+
+            const uint32_t MAP_SIZE_X;
+            const uint32_t MAP_SIZE_Y;
+            const uint32_t CLUSTER_SIZE;
+
+            uint32_t clusters_x;
+            uint32_t clusters_y;
+
+            const Validator extern_validade_tile;
+
+            vector<Cluster> clusters;
+
+            // entrance pairs on the border with the cluster to the right and below
+            vector<vector<std::pair<uint32_t, uint32_t>>> right_borders;
+            vector<vector<std::pair<uint32_t, uint32_t>>> bottom_borders;
+
+            vector<bool> dirty;
+            vector<uint32_t> dirty_list;
+
+            Vector2ui cluster_origin {0, 0};
+            Vector2ui cluster_extent {0, 0};
+            Basic_A_Star<ClusterValidator> local_search;
+
+        public:
+
+            Basic_HPA_Star (bool diagonal_move, uint32_t map_size_x, uint32_t map_size_y,
+                            uint32_t cluster_size, Validator extern_validade_tile)
+            : diagonal_move(diagonal_move), MAP_SIZE_X(map_size_x), MAP_SIZE_Y(map_size_y),
+              CLUSTER_SIZE(cluster_size), extern_validade_tile(extern_validade_tile),
+              local_search(diagonal_move, cluster_size, cluster_size, ClusterValidator{this}) {
+
+                this->clusters_x = (this->MAP_SIZE_X + this->CLUSTER_SIZE - 1) / this->CLUSTER_SIZE;
+                this->clusters_y = (this->MAP_SIZE_Y + this->CLUSTER_SIZE - 1) / this->CLUSTER_SIZE;
+
+                const uint32_t count = this->clusters_x * this->clusters_y;
+                this->clusters.resize(count);
+                this->right_borders.resize(count);
+                this->bottom_borders.resize(count);
+                this->dirty.resize(count, false);
+
+                for (uint32_t i = 0; i < count; i++) {
+                    this->build_borders(i);
+                }
+                for (uint32_t i = 0; i < count; i++) {
+                    this->build_cluster(i, false);
+                }
+            }
+
+            Basic_HPA_Star(const Basic_HPA_Star&) = delete;
+            Basic_HPA_Star& operator=(const Basic_HPA_Star&) = delete;
+
+            // Call after the passability of pos changed, its cluster is rebuilt
+            // on the next find() or update()
+            void tile_changed(Vector2ui pos) {
+
+                const uint32_t cluster = this->cluster_of(pos);
+                if (!this->dirty[cluster]) {
+                    this->dirty[cluster] = true;
+                    this->dirty_list.push_back(cluster);
+                }
+            }
+
+            // Rebuilds the entrances and entrance costs of every changed cluster.
+            // Entrances sit on borders shared with the 8 neighbors, so the
+            // borders that can hold a changed tile are rebuilt too (a cluster
+            // keeps its right and bottom ones, diagonal crossings reach the
+            // corners), and the neighbors refresh their entrance lists while
+            // keeping the costs between their unchanged entrances: their
+            // tiles did not change, only which of them are entrances
+            void update() {
+
+                if (this->dirty_list.empty()) {
+                    return;
+                }
+
+                vector<uint32_t> borders;
+                vector<uint32_t> affected;
+                for (const auto& i: this->dirty_list) {
+                    this->for_each_near(i, 1, [&](uint32_t near) {
+                        borders.push_back(near);
+                        affected.push_back(near);
+                    });
+                }
+
+                std::sort(borders.begin(), borders.end());
+                borders.erase(std::unique(borders.begin(), borders.end()), borders.end());
+                for (const auto& i: borders) {
+                    this->build_borders(i);
+                }
+
+                std::sort(affected.begin(), affected.end());
+                affected.erase(std::unique(affected.begin(), affected.end()), affected.end());
+                for (const auto& i: affected) {
+                    this->build_cluster(i, !this->dirty[i]);
+                }
+
+                for (const auto& i: this->dirty_list) {
+                    this->dirty[i] = false;
+                }
+                this->dirty_list.clear();
+            }
+
+            std::optional<vector<Vector2ui>> find(Vector2ui start, Vector2ui target) {
+
+                this->update();
+
+                if (start == target) {
+                    return {vector<Vector2ui>{}};
+                }
+                if (!this->validate_neighbor(target)) {
+                    return {};
+                }
+
+                const uint32_t start_cluster = this->cluster_of(start);
+                const uint32_t goal_cluster = this->cluster_of(target);
+
+                if (start_cluster == goal_cluster) {
+                    auto local = this->local_find(start_cluster, start, target);
+                    if (local) {
+                        return local;
+                    }
+                }
+
+                vector<AbstractNode> nodes;
+                std::unordered_map<uint32_t, uint32_t> ids;
+                IndexedHeap<uint32_t, AbstractLess, AbstractHandle> open_list {AbstractLess{&nodes}, AbstractHandle{&nodes}};
+
+                nodes.reserve(64);
+                nodes.emplace_back(this->index_of(start), 0, this->calculate_h(start, target), START_NODE);
+                nodes.emplace_back(this->index_of(target), NO_PATH, 0, GOAL_NODE);
+                open_list.push(START_NODE);
+
+                // cost from every entrance of the goal cluster to the goal
+                const Cluster& goal_entrances = this->clusters[goal_cluster];
+                vector<uint32_t> goal_costs(goal_entrances.entrances.size(), NO_PATH);
+                for (std::size_t i = 0; i < goal_costs.size(); i++) {
+                    const auto path = this->local_find(goal_cluster, target, this->pos_of(goal_entrances.entrances[i]));
+                    if (path) {
+                        goal_costs[i] = this->path_cost(target, *path);
+                    }
+                }
+
+                auto offer = [&](uint32_t from, uint32_t tile, uint32_t cost, uint32_t via) {
+
+                    uint32_t id;
+                    const auto found = ids.find(tile);
+                    if (found == ids.end()) {
+                        id = static_cast<uint32_t>(nodes.size());
+                        ids.emplace(tile, id);
+                        nodes.emplace_back(tile, nodes[from].g + cost, this->calculate_h(this->pos_of(tile), target), from);
+                        nodes[id].via = via;
+                        open_list.push(id);
+                        return;
+                    }
+                    id = found->second;
+                    if (!nodes[id].closed && nodes[from].g + cost < nodes[id].g) {
+                        nodes[id].g = nodes[from].g + cost;
+                        nodes[id].parent = from;
+                        nodes[id].via = via;
+                        open_list.decrease(id);
+                    }
+                };
+
+                bool goal_queued = false;
+
+                while (!open_list.empty()) {
+
+                    const uint32_t current = open_list.pop();
+                    nodes[current].closed = true;
+
+                    if (current == GOAL_NODE) {
+                        return {this->refine(nodes, start_cluster, goal_cluster)};
+                    }
+
+                    if (current == START_NODE) {
+
+                        for (const auto& i: this->clusters[start_cluster].entrances) {
+                            const auto path = this->local_find(start_cluster, start, this->pos_of(i));
+                            if (path) {
+                                offer(current, i, this->path_cost(start, *path), NO_PATH);
+                            }
+                        }
+
+                        // a start that is not a valid tile is not linked to the
+                        // abstract graph, so step out of its cluster by hand
+                        if (!this->validate_neighbor(start)) {
+                            for (int32_t y = -1; y <= 1; y++) {
+                                for (int32_t x = -1; x <= 1; x++) {
+
+                                    const Vector2i step {(int32_t)start.x + x, (int32_t)start.y + y};
+                                    if ((x == 0 && y == 0) || (!this->diagonal_move && x != 0 && y != 0) || !this->validate_neighbor(step)) {
+                                        continue;
+                                    }
+                                    const uint32_t step_cluster = this->cluster_of(step);
+                                    if (step_cluster == start_cluster) {
+                                        continue;
+                                    }
+                                    for (const auto& i: this->clusters[step_cluster].entrances) {
+                                        const auto path = this->local_find(step_cluster, step, this->pos_of(i));
+                                        if (path) {
+                                            offer(current, i, this->step_cost(start, step) + this->path_cost(step, *path), this->index_of(step));
+                                        }
+                                    }
+                                }
+                            }
+                        }
+                        continue;
+                    }
+
+                    const uint32_t tile = nodes[current].tile;
+                    const uint32_t cluster_index = this->cluster_of(this->pos_of(tile));
+                    const Cluster& cluster = this->clusters[cluster_index];
+                    const std::size_t k = cluster.entrances.size();
+                    const std::size_t entrance = std::lower_bound(cluster.entrances.begin(), cluster.entrances.end(), tile) - cluster.entrances.begin();
+
+                    // every abstract node is an entrance of its cluster, a
+                    // broken invariant drops the node instead of reading past the tables
+                    if (entrance == k || cluster.entrances[entrance] != tile) {
+                        continue;
+                    }
+
+                    for (std::size_t i = 0; i < k; i++) {
+                        const uint32_t cost = cluster.costs[entrance * k + i];
+                        if (i != entrance && cost != NO_PATH) {
+                            offer(current, cluster.entrances[i], cost, NO_PATH);
+                        }
+                    }
+                    for (const auto& i: cluster.links[entrance]) {
+                        offer(current, i, this->step_cost(this->pos_of(tile), this->pos_of(i)), NO_PATH);
+                    }
+
+                    if (cluster_index == goal_cluster && goal_costs[entrance] != NO_PATH) {
+                        const uint32_t g = nodes[current].g + goal_costs[entrance];
+                        if (!goal_queued || g < nodes[GOAL_NODE].g) {
+                            nodes[GOAL_NODE].g = g;
+                            nodes[GOAL_NODE].parent = current;
+                            if (goal_queued) {
+                                open_list.decrease(GOAL_NODE);
+                            }
+                            else {
+                                open_list.push(GOAL_NODE);
+                                goal_queued = true;
+                            }
+                        }
+                    }
+                }
+
+                return {};
+            }
+
+        private:
+
+            [[nodiscard]]
+            inline uint32_t index_of(const Vector2ui& pos) const noexcept {
+                return pos.y * this->MAP_SIZE_X + pos.x;
+            }
+
+            [[nodiscard]]
+            inline Vector2ui pos_of(uint32_t index) const noexcept {
+                return {index % this->MAP_SIZE_X, index / this->MAP_SIZE_X};
+            }
+
+            [[nodiscard]]
+            inline uint32_t cluster_of(const Vector2ui& pos) const noexcept {
+                return (pos.y / this->CLUSTER_SIZE) * this->clusters_x + pos.x / this->CLUSTER_SIZE;
+            }
+
+            [[nodiscard]]
+            inline Vector2ui origin_of(uint32_t cluster) const noexcept {
+                return {(cluster % this->clusters_x) * this->CLUSTER_SIZE, (cluster / this->clusters_x) * this->CLUSTER_SIZE};
+            }
+
+            [[nodiscard]]
+            inline Vector2ui extent_of(uint32_t cluster) const noexcept {
+                const Vector2ui origin = this->origin_of(cluster);
+                return {std::min(this->CLUSTER_SIZE, this->MAP_SIZE_X - origin.x), std::min(this->CLUSTER_SIZE, this->MAP_SIZE_Y - origin.y)};
+            }
+
+            [[nodiscard]]
+            inline bool validate_neighbor(Vector2i pos) const noexcept {
+
+                if (pos.x < 0 || (uint32_t)pos.x >= this->MAP_SIZE_X || pos.y < 0 || (uint32_t)pos.y >= this->MAP_SIZE_Y) {
+                    return false;
+                }
+                return this->extern_validade_tile(pos);
+            }
+
+            // Same costs and heuristic as A_Star
+            [[nodiscard]]
+            inline uint32_t step_cost(const Vector2ui& a, const Vector2ui& b) const noexcept {
+
+                if (this->diagonal_move && a.OrthogonalTo(b)) {
+                    return 10;
+                }
+                else {
+                    return 14;
+                }
+            }
+
+            [[nodiscard]]
+            inline uint32_t calculate_h(const Vector2ui& pos, const Vector2ui& target) const noexcept {
+
+                Vector2i delta {abs(static_cast<int32_t>(pos.x - target.x)), abs(static_cast<int32_t>(pos.y - target.y))};
+
+                if (this->diagonal_move) {
+                    const int32_t diagonal = std::min(delta.x, delta.y);
+                    return 10 * (std::max(delta.x, delta.y) - diagonal) + 14 * diagonal;
+                }
+                else {
+                    return (10 * (delta.x + delta.y));
+                }
+            }
+
+            [[nodiscard]]
+            uint32_t path_cost(Vector2ui from, const vector<Vector2ui>& path) const noexcept {
+
+                uint32_t cost = 0;
+                for (const auto& i: path) {
+                    cost += this->step_cost(from, i);
+                    from = i;
+                }
+                return cost;
+            }
+
+            // A_Star restricted to one cluster, in map coordinates
+            std::optional<vector<Vector2ui>> local_find(uint32_t cluster, const Vector2ui& from, const Vector2ui& to) {
+
+                if (from == to) {
+                    return {vector<Vector2ui>{}};
+                }
+
+                this->cluster_origin = this->origin_of(cluster);
+                this->cluster_extent = this->extent_of(cluster);
+
+                auto path = this->local_search.find(from - this->cluster_origin, to - this->cluster_origin);
+                if (path) {
+                    for (auto& i: *path) {
+                        i = i + this->cluster_origin;
+                    }
+                }
+                return path;
+            }
+
+            // Finds the entrance pairs on the right and bottom borders of cluster.
+            // Runs of orthogonal crossings get entrances as in the paper, with
+            // diagonal moves every diagonal crossing that no run already covers
+            // (including the ones into a diagonal cluster) gets its own
+            void build_borders(uint32_t cluster) {
+
+                const Vector2ui c {cluster % this->clusters_x, cluster / this->clusters_x};
+                const Vector2ui origin = this->origin_of(cluster);
+                const Vector2ui extent = this->extent_of(cluster);
+
+                auto build = [&](vector<std::pair<uint32_t, uint32_t>>& border, const Vector2i& first, const Vector2i& across, const Vector2i& along, uint32_t length) {
+
+                    border.clear();
+
+                    auto tile = [&](int32_t i) {
+                        return Vector2i{first.x + along.x * i, first.y + along.y * i};
+                    };
+
+                    vector<bool> crossing(length);
+                    for (uint32_t i = 0; i < length; i++) {
+                        crossing[i] = this->validate_neighbor(tile(i)) && this->validate_neighbor(tile(i) + across);
+                    }
+
+                    uint32_t run = 0;
+                    for (uint32_t i = 0; i <= length; i++) {
+
+                        if (i < length && crossing[i]) {
+                            run++;
+                            continue;
+                        }
+                        if (run == 0) {
+                            continue;
+                        }
+
+                        const uint32_t begin = i - run;
+                        vector<uint32_t> picks;
+                        if (run <= MAX_SINGLE_ENTRANCE) {
+                            picks.push_back(begin + (run - 1) / 2);
+                        }
+                        else {
+                            picks.push_back(begin);
+                            picks.push_back(i - 1);
+                        }
+                        for (const auto& j: picks) {
+                            border.push_back({this->index_of(tile(j)), this->index_of(tile(j) + across)});
+                        }
+                        run = 0;
+                    }
+
+                    if (!this->diagonal_move) {
+                        return;
+                    }
+
+                    for (uint32_t i = 0; i < length; i++) {
+
+                        if (!this->validate_neighbor(tile(i))) {
+                            continue;
+                        }
+                        for (int32_t side = -1; side <= 1; side += 2) {
+
+                            const int32_t j = (int32_t)i + side;
+                            const Vector2i other = tile(j) + across;
+                            if (!this->validate_neighbor(other)) {
+                                continue;
+                            }
+                            const bool into_diagonal_cluster = j < 0 || j >= (int32_t)length;
+                            if (into_diagonal_cluster || (!crossing[i] && !crossing[j])) {
+                                border.push_back({this->index_of(tile(i)), this->index_of(other)});
+                            }
+                        }
+                    }
+                };
+
+                this->right_borders[cluster].clear();
+                this->bottom_borders[cluster].clear();
+
+                if (c.x + 1 < this->clusters_x) {
+                    build(this->right_borders[cluster], Vector2ui{origin.x + extent.x - 1, origin.y}, {1, 0}, {0, 1}, extent.y);
+                }
+                if (c.y + 1 < this->clusters_y) {
+                    build(this->bottom_borders[cluster], Vector2ui{origin.x, origin.y + extent.y - 1}, {0, 1}, {1, 0}, extent.x);
+                }
+            }
+
+            // Calls f with every existing cluster within radius of cluster
+            template<typename F>
+            void for_each_near(uint32_t cluster, int32_t radius, F f) const noexcept {
+
+                const int32_t cx = cluster % this->clusters_x;
+                const int32_t cy = cluster / this->clusters_x;
+                for (int32_t y = cy - radius; y <= cy + radius; y++) {
+                    for (int32_t x = cx - radius; x <= cx + radius; x++) {
+                        if (x >= 0 && y >= 0 && (uint32_t)x < this->clusters_x && (uint32_t)y < this->clusters_y) {
+                            f(y * this->clusters_x + x);
+                        }
+                    }
+                }
+            }
+
+            // Collects the entrances of cluster from the borders around it and
+            // computes the costs between them. With keep_costs the cluster's
+            // tiles did not change, so costs of surviving entrance pairs are reused
+            void build_cluster(uint32_t cluster, bool keep_costs) {
+
+                vector<std::pair<uint32_t, uint32_t>> pairs;
+                this->for_each_near(cluster, 1, [&](uint32_t near) {
+                    for (const auto* border: {&this->right_borders[near], &this->bottom_borders[near]}) {
+                        for (const auto& i: *border) {
+                            if (near == cluster) {
+                                pairs.push_back(i);
+                            }
+                            else if (this->cluster_of(this->pos_of(i.second)) == cluster) {
+                                pairs.push_back({i.second, i.first});
+                            }
+                        }
+                    }
+                });
+                std::sort(pairs.begin(), pairs.end());
+                pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+
+                Cluster rebuilt;
+                for (const auto& i: pairs) {
+                    if (rebuilt.entrances.empty() || rebuilt.entrances.back() != i.first) {
+                        rebuilt.entrances.push_back(i.first);
+                        rebuilt.links.emplace_back();
+                    }
+                    rebuilt.links.back().push_back(i.second);
+                }
+
+                const Cluster& old = this->clusters[cluster];
+                const std::size_t k = rebuilt.entrances.size();
+                rebuilt.costs.assign(k * k, NO_PATH);
+
+                for (std::size_t i = 0; i < k; i++) {
+                    rebuilt.costs[i * k + i] = 0;
+                    for (std::size_t j = i + 1; j < k; j++) {
+
+                        uint32_t cost = NO_PATH;
+                        bool known = false;
+                        if (keep_costs) {
+                            const auto a = std::lower_bound(old.entrances.begin(), old.entrances.end(), rebuilt.entrances[i]);
+                            const auto b = std::lower_bound(old.entrances.begin(), old.entrances.end(), rebuilt.entrances[j]);
+                            if (a != old.entrances.end() && *a == rebuilt.entrances[i] &&
+                                b != old.entrances.end() && *b == rebuilt.entrances[j]) {
+                                cost = old.costs[(a - old.entrances.begin()) * old.entrances.size() + (b - old.entrances.begin())];
+                                known = true;
+                            }
+                        }
+                        if (!known) {
+                            const Vector2ui from = this->pos_of(rebuilt.entrances[i]);
+                            const auto path = this->local_find(cluster, from, this->pos_of(rebuilt.entrances[j]));
+                            if (path) {
+                                cost = this->path_cost(from, *path);
+                            }
+                        }
+                        rebuilt.costs[i * k + j] = cost;
+                        rebuilt.costs[j * k + i] = cost;
+                    }
+                }
+
+                this->clusters[cluster] = std::move(rebuilt);
+            }
+
+            // Turns the abstract path ending at the goal into tiles
+            vector<Vector2ui> refine(const vector<AbstractNode>& nodes, uint32_t start_cluster, uint32_t goal_cluster) {
+
+                vector<uint32_t> chain;
+                for (uint32_t i = GOAL_NODE; i != START_NODE; i = nodes[i].parent) {
+                    chain.push_back(i);
+                }
+                chain.push_back(START_NODE);
+                std::reverse(chain.begin(), chain.end());
+
+                vector<Vector2ui> result;
+                for (std::size_t i = 1; i < chain.size(); i++) {
+
+                    Vector2ui from = this->pos_of(nodes[chain[i - 1]].tile);
+                    const Vector2ui to = this->pos_of(nodes[chain[i]].tile);
+
+                    uint32_t cluster;
+                    if (nodes[chain[i]].via != NO_PATH) {
+                        from = this->pos_of(nodes[chain[i]].via);
+                        result.push_back(from);
+                        cluster = this->cluster_of(from);
+                    }
+                    else if (chain[i - 1] == START_NODE) {
+                        cluster = start_cluster;
+                    }
+                    else if (chain[i] == GOAL_NODE) {
+                        cluster = goal_cluster;
+                    }
+                    else if (this->cluster_of(from) == this->cluster_of(to)) {
+                        cluster = this->cluster_of(from);
+                    }
+                    else {
+                        result.push_back(to);
+                        continue;
+                    }
+
+                    const auto segment = this->local_find(cluster, from, to);
+                    if (segment) {
+                        result.insert(result.end(), segment->begin(), segment->end());
+                    }
+                }
+                return result;
+            }
+    };
+
+    using HPA_Star = Basic_HPA_Star<std::function<bool(Vector2i&)>>;
+
+
+    // D* Lite (Koenig & Likhachev) over the same grid model as A_Star. It
+    // searches from the target back to the start and keeps that search tree
+    // between calls, so after the agent moves or a few tiles change only the
+    // inconsistent part of the tree is repaired instead of searching again
+    template<typename Validator>
+    class Basic_D_Star_Lite {
+
+        static constexpr uint32_t INFINITE = UINT32_MAX;
+
+        class Node {
+
+            public:
+
+                uint32_t g;
+                uint32_t rhs;
+
+                // priority while queued, compared as a pair
+                uint32_t key_first;
+                uint32_t key_second;
+
+                uint32_t heap_index;
+                bool queued;
+
+                // search that last touched the node, older nodes read as unvisited
+                uint32_t generation;
+
+                Node() {
+                    g = INFINITE;
+                    rhs = INFINITE;
+                    key_first = 0;
+                    key_second = 0;
+                    heap_index = 0;
+                    queued = false;
+                    generation = 0;
+                }
+        };
+
+        struct NodeLess {
+            const vector<Node>* nodes;
+
+            inline bool operator()(uint32_t a, uint32_t b) const noexcept {
+                const Node& node_a = (*this->nodes)[a];
+                const Node& node_b = (*this->nodes)[b];
+                if (node_a.key_first != node_b.key_first) {
+                    return node_a.key_first < node_b.key_first;
+                }
+                if (node_a.key_second != node_b.key_second) {
+                    return node_a.key_second < node_b.key_second;
+                }
+                return a < b;
+            }
+        };
+
+        struct NodeHandle {
+            vector<Node>* nodes;
+
+            inline uint32_t& operator()(uint32_t node) const noexcept {
+                return (*this->nodes)[node].heap_index;
+            }
+        };
+
+        private:
+
+            uint8_t ORTHOGONAL_COST = 10;
+            uint8_t DIAGONAL_COST   = 14;
+
+            bool diagonal_move;
+            vector<Vector2i> directions;
+
+            const uint32_t MAP_SIZE_X;
+            const uint32_t MAP_SIZE_Y;
+
+            const Validator extern_validade_tile;
+
+            vector<Node> nodes;
+            uint32_t generation = 0;
+            IndexedHeap<uint32_t, NodeLess, NodeHandle> open_list;
+
+            Vector2ui start {0, 0};
+            Vector2ui target {0, 0};
+            Vector2ui last_start {0, 0};
+            uint32_t key_modifier = 0;
+            bool planned = false;
+
+        public:
+
+            Basic_D_Star_Lite (bool diagonal_move, uint32_t map_size_x, uint32_t map_size_y,
+                               Validator extern_validade_tile)
+            : diagonal_move(diagonal_move), MAP_SIZE_X(map_size_x), MAP_SIZE_Y(map_size_y),
+              extern_validade_tile(extern_validade_tile),
+              nodes(static_cast<std::size_t>(map_size_x) * map_size_y),
+              open_list{NodeLess{&nodes}, NodeHandle{&nodes}} {
+
+                this->directions.push_back({0, -1});
+                this->directions.push_back({1, 0});
+                this->directions.push_back({0, 1});
+                this->directions.push_back({-1, 0});
+
+                if (this->diagonal_move) {
+                    this->directions.push_back({1, -1});
+                    this->directions.push_back({1, 1});
+                    this->directions.push_back({-1, -1});
+                    this->directions.push_back({-1, 1});
+                }
+            }
+
+            Basic_D_Star_Lite(const Basic_D_Star_Lite&) = delete;
+            Basic_D_Star_Lite& operator=(const Basic_D_Star_Lite&) = delete;
+
+            // Starts planning towards a new target, dropping the old search tree
+            void reset(Vector2ui start, Vector2ui target) noexcept {
+
+                this->generation++;
+                if (this->generation == 0) {
+                    for (auto& i: this->nodes) {
+                        i.generation = 0;
+                    }
+                    this->generation = 1;
+                }
+                this->open_list.clear();
+
+                this->start = start;
+                this->last_start = start;
+                this->target = target;
+                this->key_modifier = 0;
+                this->planned = true;
+
+                const uint32_t goal = this->index_of(target);
+                this->node(goal).rhs = 0;
+                this->enqueue(goal);
+            }
+
+            // The agent moved to start, the tree is kept
+            void move_start(Vector2ui start) noexcept {
+
+                this->key_modifier += this->calculate_h(this->last_start, start);
+                this->last_start = start;
+                this->start = start;
+            }
+
+            // Call with every tile whose validity changed since the last find()
+            void update_tiles(const vector<Vector2ui>& changed) noexcept {
+
+                if (!this->planned) {
+                    return;
+                }
+                for (const auto& i: changed) {
+                    // entering i got cheaper or more expensive, which is an
+                    // outgoing edge of each of its neighbors
+                    for (const auto& j: this->directions) {
+                        const Vector2i pos = (Vector2i)i + j;
+                        if (this->in_bounds(pos)) {
+                            this->update_vertex(this->index_of(pos));
+                        }
+                    }
+                }
+            }
+
+            // Repairs the search tree and returns the path from start to target
+            std::optional<vector<Vector2ui>> find() noexcept {
+
+                if (!this->planned) {
+                    return {};
+                }
+
+                this->compute_shortest_path();
+
+                const uint32_t goal = this->index_of(this->target);
+                uint32_t current = this->index_of(this->start);
+                if (this->node(current).g == INFINITE) {
+                    return {};
+                }
+
+                vector<Vector2ui> result;
+                while (current != goal) {
+
+                    uint32_t best = INFINITE;
+                    uint32_t best_cost = INFINITE;
+                    const Vector2ui pos = this->pos_of(current);
+                    for (const auto& i: this->directions) {
+                        const Vector2i next = (Vector2i)pos + i;
+                        if (!this->validate_neighbor(next)) {
+                            continue;
+                        }
+                        const uint32_t next_index = this->index_of(next);
+                        const uint32_t cost = this->add(this->step_cost(i), this->node(next_index).g);
+                        if (cost < best_cost) {
+                            best_cost = cost;
+                            best = next_index;
+                        }
+                    }
+                    if (best == INFINITE || result.size() >= this->nodes.size()) {
+                        return {};
+                    }
+                    current = best;
+                    result.push_back(this->pos_of(current));
+                }
+                return {result};
+            }
+
+        private:
+
+            [[nodiscard]]
+            inline uint32_t index_of(const Vector2ui& pos) const noexcept {
+                return pos.y * this->MAP_SIZE_X + pos.x;
+            }
+
+            [[nodiscard]]
+            inline Vector2ui pos_of(uint32_t index) const noexcept {
+                return {index % this->MAP_SIZE_X, index / this->MAP_SIZE_X};
+            }
+
+            [[nodiscard]]
+            inline bool in_bounds(const Vector2i& pos) const noexcept {
+                return pos.x >= 0 && pos.y >= 0 && (uint32_t)pos.x < this->MAP_SIZE_X && (uint32_t)pos.y < this->MAP_SIZE_Y;
+            }
+
+            [[nodiscard]]
+            inline bool validate_neighbor(Vector2i pos) const noexcept {
+
+                if (!this->in_bounds(pos)) {
+                    return false;
+                }
+                return this->extern_validade_tile(pos);
+            }
+
+            // The node, reset if an older plan touched it last
+            [[nodiscard]]
+            inline Node& node(uint32_t index) noexcept {
+
+                Node& node = this->nodes[index];
+                if (node.generation != this->generation) {
+                    node = Node();
+                    node.generation = this->generation;
+                }
+                return node;
+            }
+
+            [[nodiscard]]
+            static inline uint32_t add(uint32_t a, uint32_t b) noexcept {
+                return (a == INFINITE || b == INFINITE) ? INFINITE : a + b;
+            }
+
+            // Cost of one step in dir, as in A_Star
+            [[nodiscard]]
+            inline uint8_t step_cost(const Vector2i& dir) const noexcept {
+
+                if (this->diagonal_move && (dir.x == 0 || dir.y == 0)) {
+                    return this->ORTHOGONAL_COST;
+                }
+                else {
+                    return this->DIAGONAL_COST;
+                }
+            }
+
+            [[nodiscard]]
+            inline uint32_t calculate_h(const Vector2ui& a, const Vector2ui& b) const noexcept {
+
+                Vector2i delta {abs(static_cast<int32_t>(a.x - b.x)), abs(static_cast<int32_t>(a.y - b.y))};
+
+                if (this->diagonal_move) {
+                    // euclidean
+                    return (10 * sqrt(pow(delta.x, 2) + pow(delta.y, 2)));
+                }
+                else {
+                    // manhattan
+                    return (10 * (delta.x + delta.y));
+                }
+            }
+
+            [[nodiscard]]
+            inline std::pair<uint32_t, uint32_t> calculate_key(uint32_t index) noexcept {
+
+                const Node& node = this->node(index);
+                const uint32_t best = std::min(node.g, node.rhs);
+                return {this->add(this->add(best, this->calculate_h(this->start, this->pos_of(index))), this->key_modifier), best};
+            }
+
+            inline void enqueue(uint32_t index) noexcept {
+
+                const auto key = this->calculate_key(index);
+                Node& node = this->node(index);
+                node.key_first = key.first;
+                node.key_second = key.second;
+                if (node.queued) {
+                    this->open_list.update(index);
+                }
+                else {
+                    node.queued = true;
+                    this->open_list.push(index);
+                }
+            }
+
+            inline void dequeue(uint32_t index) noexcept {
+
+                Node& node = this->node(index);
+                if (node.queued) {
+                    node.queued = false;
+                    this->open_list.remove(index);
+                }
+            }
+
+            void update_vertex(uint32_t index) noexcept {
+
+                Node& node = this->node(index);
+
+                if (index != this->index_of(this->target)) {
+                    node.rhs = INFINITE;
+                    const Vector2ui pos = this->pos_of(index);
+                    for (const auto& i: this->directions) {
+                        const Vector2i next = (Vector2i)pos + i;
+                        if (this->validate_neighbor(next)) {
+                            node.rhs = std::min(node.rhs, this->add(this->step_cost(i), this->node(this->index_of(next)).g));
+                        }
+                    }
+                }
+
+                if (node.g != node.rhs) {
+                    this->enqueue(index);
+                }
+                else {
+                    this->dequeue(index);
+                }
+            }
+
+            // Tiles that can step into index
+            template<typename F>
+            inline void for_each_predecessor(uint32_t index, F f) const noexcept {
+
+                const Vector2ui pos = this->pos_of(index);
+                for (const auto& i: this->directions) {
+                    const Vector2i prev = (Vector2i)pos - i;
+                    if (this->in_bounds(prev)) {
+                        f(this->index_of(prev));
+                    }
+                }
+            }
+
+            void compute_shortest_path() noexcept {
+
+                const uint32_t start_index = this->index_of(this->start);
+
+                while (!this->open_list.empty()) {
+
+                    const Node& start_node = this->node(start_index);
+                    const bool start_consistent = start_node.g == start_node.rhs;
+
+                    const uint32_t top = this->open_list.top();
+                    const std::pair<uint32_t, uint32_t> old_key {this->node(top).key_first, this->node(top).key_second};
+                    if (!(old_key < this->calculate_key(start_index)) && start_consistent) {
+                        break;
+                    }
+
+                    const std::pair<uint32_t, uint32_t> new_key = this->calculate_key(top);
+                    Node& node = this->node(top);
+                    if (old_key < new_key) {
+                        // the agent moved since the node was queued
+                        this->enqueue(top);
+                        continue;
+                    }
+
+                    this->open_list.pop();
+                    node.queued = false;
+
+                    // a tile that can not be entered adds no edges to its predecessors
+                    const bool valid = this->validate_neighbor(this->pos_of(top));
+
+                    if (node.g > node.rhs) {
+                        node.g = node.rhs;
+                        if (valid) {
+                            this->for_each_predecessor(top, [this](uint32_t i) { this->update_vertex(i); });
+                        }
+                    }
+                    else {
+                        node.g = INFINITE;
+                        this->update_vertex(top);
+                        if (valid) {
+                            this->for_each_predecessor(top, [this](uint32_t i) { this->update_vertex(i); });
+                        }
+                    }
+                }
+            }
+    };
+
+    using D_Star_Lite = Basic_D_Star_Lite<std::function<bool(Vector2i&)>>;
+
+
+    // Flow field for many agents sharing one goal. generate() runs a single
+    // Dijkstra from the goal over the whole map (integration field) and keeps
+    // for every tile the direction of its cheapest next step, after that
+    // next_step() is a table lookup. Uses A_Star's grid model and move costs
+    template<typename Validator>
+    class Basic_FlowField {
+
+        static constexpr uint32_t INFINITE = UINT32_MAX;
+        static constexpr uint32_t NOT_QUEUED = UINT32_MAX;
+        static constexpr uint8_t NO_DIRECTION = UINT8_MAX;
+
+        class Field {
+
+            public:
+
+                Vector2ui goal {0, 0};
+
+                // cost to reach the goal from each tile, INFINITE if it can't
+                vector<uint32_t> integration;
+
+                // index in directions of the next step, NO_DIRECTION at the
+                // goal and on tiles that can't reach it
+                vector<uint8_t> next;
+
+                vector<uint32_t> heap_index;
+
+                Field(std::size_t size)
+                : integration(size, INFINITE), next(size, NO_DIRECTION), heap_index(size, NOT_QUEUED) {}
+        };
+
+        struct FieldLess {
+            const vector<uint32_t>* integration;
+
+            inline bool operator()(uint32_t a, uint32_t b) const noexcept {
+                if ((*this->integration)[a] != (*this->integration)[b]) {
+                    return (*this->integration)[a] < (*this->integration)[b];
+                }
+                return a < b;
+            }
+        };
+
+        struct FieldHandle {
+            vector<uint32_t>* heap_index;
+
+            inline uint32_t& operator()(uint32_t tile) const noexcept {
+                return (*this->heap_index)[tile];
+            }
+        };
+
+        using OpenList = IndexedHeap<uint32_t, FieldLess, FieldHandle>;
+
+        private:
+
+            uint8_t ORTHOGONAL_COST = 10;
+            uint8_t DIAGONAL_COST   = 14;
+
+            bool diagonal_move;
+            vector<Vector2i> directions;
+
+            const uint32_t MAP_SIZE_X;
+            const uint32_t MAP_SIZE_Y;
+
+            const Validator extern_validade_tile;
+
+            std::unique_ptr<Field> field;
+
+            std::unique_ptr<Field> pending;
+            std::future<void> pending_done;
+
+        public:
+
+            Basic_FlowField (bool diagonal_move, uint32_t map_size_x, uint32_t map_size_y,
+                             Validator extern_validade_tile)
+            : diagonal_move(diagonal_move), MAP_SIZE_X(map_size_x), MAP_SIZE_Y(map_size_y),
+              extern_validade_tile(extern_validade_tile) {
+
+                this->directions.push_back({0, -1});
+                this->directions.push_back({1, 0});
+                this->directions.push_back({0, 1});
+                this->directions.push_back({-1, 0});
+
+                if (this->diagonal_move) {
+                    this->directions.push_back({1, -1});
+                    this->directions.push_back({1, 1});
+                    this->directions.push_back({-1, -1});
+                    this->directions.push_back({-1, 1});
+                }
+
+                this->field = std::make_unique<Field>(this->map_area());
+            }
+
+            ~Basic_FlowField() {
+                if (this->pending_done.valid()) {
+                    this->pending_done.wait();
+                }
+            }
+
+            Basic_FlowField(const Basic_FlowField&) = delete;
+            Basic_FlowField& operator=(const Basic_FlowField&) = delete;
+
+            void generate(Vector2ui goal) noexcept {
+                this->integrate(*this->field, goal);
+            }
+
+            // Builds the field for goal on one of the pool's workers, lookups
+            // keep using the current field until poll() swaps the new one in.
+            // extern_validade_tile must be safe to call from that worker
+            void generate_async(Vector2ui goal, ThreadPool& pool) {
+
+                if (this->pending_done.valid()) {
+                    this->pending_done.wait();
+                }
+                this->pending = std::make_unique<Field>(this->map_area());
+                Field* target = this->pending.get();
+                this->pending_done = pool.submit([this, target, goal]() { this->integrate(*target, goal); });
+            }
+
+            // Swaps in the field of a finished generate_async(), returns true if it did
+            bool poll() {
+
+                if (!this->pending_done.valid() ||
+                    this->pending_done.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                    return false;
+                }
+                this->pending_done.get();
+                this->field = std::move(this->pending);
+                return true;
+            }
+
+            // Call with every tile whose validity changed. Tiles that relied on
+            // a tile that got blocked are reset and refilled from their
+            // neighbors, a tile that got freed spreads its cost outwards
+            void update_tiles(const vector<Vector2ui>& changed) noexcept {
+
+                Field& field = *this->field;
+                OpenList open_list {FieldLess{&field.integration}, FieldHandle{&field.heap_index}};
+
+                vector<uint32_t> reset;
+                vector<bool> in_reset;
+                for (const auto& i: changed) {
+
+                    const uint32_t tile = this->index_of(i);
+                    if (!this->expands(field, tile)) {
+                        if (in_reset.empty()) {
+                            in_reset.resize(this->map_area(), false);
+                        }
+                        this->collect_dependents(field, tile, reset, in_reset);
+                    }
+                }
+
+                for (const auto& i: reset) {
+                    field.integration[i] = INFINITE;
+                    field.next[i] = NO_DIRECTION;
+                }
+                for (const auto& i: reset) {
+                    const Vector2ui pos = this->pos_of(i);
+                    for (uint8_t d = 0; d < this->directions.size(); d++) {
+                        const Vector2i from = (Vector2i)pos + this->directions[d];
+                        if (!this->in_bounds(from)) {
+                            continue;
+                        }
+                        const uint32_t from_tile = this->index_of(from);
+                        if (field.integration[from_tile] != INFINITE && this->expands(field, from_tile)) {
+                            const uint32_t cost = field.integration[from_tile] + this->step_cost(this->directions[d]);
+                            if (cost < field.integration[i]) {
+                                field.integration[i] = cost;
+                                field.next[i] = d;
+                            }
+                        }
+                    }
+                    if (field.integration[i] != INFINITE) {
+                        this->enqueue(field, open_list, i);
+                    }
+                }
+
+                for (const auto& i: changed) {
+                    const uint32_t tile = this->index_of(i);
+                    if (this->expands(field, tile) && field.integration[tile] != INFINITE) {
+                        this->enqueue(field, open_list, tile);
+                    }
+                }
+
+                this->propagate(field, open_list);
+            }
+
+            // Tile to move to from pos, nothing at the goal or if it can't be reached
+            [[nodiscard]]
+            inline std::optional<Vector2ui> next_step(const Vector2ui& pos) const noexcept {
+
+                const uint8_t next = this->field->next[this->index_of(pos)];
+                if (next == NO_DIRECTION) {
+                    return {};
+                }
+                return {pos + this->directions[next]};
+            }
+
+            // Cost from pos to the goal, nothing if it can't be reached
+            [[nodiscard]]
+            inline std::optional<uint32_t> cost(const Vector2ui& pos) const noexcept {
+
+                const uint32_t cost = this->field->integration[this->index_of(pos)];
+                if (cost == INFINITE) {
+                    return {};
+                }
+                return {cost};
+            }
+
+            [[nodiscard]]
+            inline Vector2ui goal() const noexcept {
+                return this->field->goal;
+            }
+
+        private:
+
+            [[nodiscard]]
+            inline std::size_t map_area() const noexcept {
+                return static_cast<std::size_t>(this->MAP_SIZE_X) * this->MAP_SIZE_Y;
+            }
+
+            [[nodiscard]]
+            inline uint32_t index_of(const Vector2ui& pos) const noexcept {
+                return pos.y * this->MAP_SIZE_X + pos.x;
+            }
+
+            [[nodiscard]]
+            inline Vector2ui pos_of(uint32_t index) const noexcept {
+                return {index % this->MAP_SIZE_X, index / this->MAP_SIZE_X};
+            }
+
+            [[nodiscard]]
+            inline bool in_bounds(const Vector2i& pos) const noexcept {
+                return pos.x >= 0 && pos.y >= 0 && (uint32_t)pos.x < this->MAP_SIZE_X && (uint32_t)pos.y < this->MAP_SIZE_Y;
+            }
+
+            [[nodiscard]]
+            inline bool validate_neighbor(Vector2i pos) const noexcept {
+
+                if (!this->in_bounds(pos)) {
+                    return false;
+                }
+                return this->extern_validade_tile(pos);
+            }
+
+            // Cost of one step in dir, as in A_Star
+            [[nodiscard]]
+            inline uint8_t step_cost(const Vector2i& dir) const noexcept {
+
+                if (this->diagonal_move && (dir.x == 0 || dir.y == 0)) {
+                    return this->ORTHOGONAL_COST;
+                }
+                else {
+                    return this->DIAGONAL_COST;
+                }
+            }
+
+            // Whether paths can pass through tile: the goal and valid tiles.
+            // Invalid tiles still get a cost so agents standing on one can leave
+            [[nodiscard]]
+            inline bool expands(const Field& field, uint32_t tile) const noexcept {
+                return tile == this->index_of(field.goal) || this->validate_neighbor(this->pos_of(tile));
+            }
+
+            static inline void enqueue(Field& field, OpenList& open_list, uint32_t tile) noexcept {
+
+                if (field.heap_index[tile] == NOT_QUEUED) {
+                    open_list.push(tile);
+                }
+                else {
+                    open_list.decrease(tile);
+                }
+            }
+
+            void integrate(Field& field, const Vector2ui& goal) const noexcept {
+
+                std::fill(field.integration.begin(), field.integration.end(), INFINITE);
+                std::fill(field.next.begin(), field.next.end(), NO_DIRECTION);
+                std::fill(field.heap_index.begin(), field.heap_index.end(), NOT_QUEUED);
+                field.goal = goal;
+
+                OpenList open_list {FieldLess{&field.integration}, FieldHandle{&field.heap_index}};
+
+                const uint32_t goal_tile = this->index_of(goal);
+                field.integration[goal_tile] = 0;
+                open_list.push(goal_tile);
+
+                this->propagate(field, open_list);
+            }
+
+            // Dijkstra from the queued tiles, lowering costs only
+            void propagate(Field& field, OpenList& open_list) const noexcept {
+
+                while (!open_list.empty()) {
+
+                    const uint32_t tile = open_list.pop();
+                    field.heap_index[tile] = NOT_QUEUED;
+
+                    if (!this->expands(field, tile)) {
+                        continue;
+                    }
+
+                    const Vector2ui pos = this->pos_of(tile);
+                    for (uint8_t d = 0; d < this->directions.size(); d++) {
+
+                        // the tile one step against d moves to pos by going d
+                        const Vector2i from = (Vector2i)pos - this->directions[d];
+                        if (!this->in_bounds(from)) {
+                            continue;
+                        }
+                        const uint32_t from_tile = this->index_of(from);
+                        const uint32_t cost = field.integration[tile] + this->step_cost(this->directions[d]);
+                        if (cost < field.integration[from_tile]) {
+                            field.integration[from_tile] = cost;
+                            field.next[from_tile] = d;
+                            this->enqueue(field, open_list, from_tile);
+                        }
+                    }
+                }
+            }
+
+            // Adds tile and every tile whose next steps lead through it
+            void collect_dependents(const Field& field, uint32_t tile, vector<uint32_t>& reset, vector<bool>& in_reset) const noexcept {
+
+                if (in_reset[tile] || tile == this->index_of(field.goal)) {
+                    return;
+                }
+                const std::size_t first = reset.size();
+                in_reset[tile] = true;
+                reset.push_back(tile);
+
+                for (std::size_t i = first; i < reset.size(); i++) {
+                    const Vector2ui pos = this->pos_of(reset[i]);
+                    for (uint8_t d = 0; d < this->directions.size(); d++) {
+                        const Vector2i from = (Vector2i)pos - this->directions[d];
+                        if (!this->in_bounds(from)) {
+                            continue;
+                        }
+                        const uint32_t from_tile = this->index_of(from);
+                        if (!in_reset[from_tile] && field.next[from_tile] == d) {
+                            in_reset[from_tile] = true;
+                            reset.push_back(from_tile);
+                        }
+                    }
+                }
+            }
+    };
+
+    using FlowField = Basic_FlowField<std::function<bool(Vector2i&)>>;
+
+
+    // SIMD lanes for Basic_PerlinNoise's batch kernels, a reg holds size
+    // values of T and an ireg as many int32. ScalarLanes is the fallback
+    // and runs the tails
+    template<typename T>
+    struct ScalarLanes {
+        using reg = T;
+        using ireg = std::int32_t;
+        static constexpr std::size_t size = 1;
+
+        static inline reg load(const T* from) noexcept { return *from; }
+        static inline void store(T* to, reg value) noexcept { *to = value; }
+        static inline reg set1(T value) noexcept { return value; }
+        static inline reg add(reg a, reg b) noexcept { return a + b; }
+        static inline reg sub(reg a, reg b) noexcept { return a - b; }
+        static inline reg mul(reg a, reg b) noexcept { return a * b; }
+        static inline reg floor(reg a) noexcept { return std::floor(a); }
+
+        // lattice cells of floored coordinates, wrapped to the permutation
+        static inline ireg cells(reg floored) noexcept { return static_cast<std::int32_t>(floored) & 255; }
+        static inline ireg iadd(ireg a, ireg b) noexcept { return a + b; }
+        static inline ireg iset1(std::int32_t value) noexcept { return value; }
+        static inline ireg gather(const std::int32_t* table, ireg index) noexcept { return table[index]; }
+
+        // table[hash & 15]
+        static inline reg gather_grad(const T* table, ireg hash) noexcept { return table[hash & 15]; }
+    };
+
+#if defined(BOAR_SIMD_AVX2)
+    template<typename T>
+    struct NoiseLanes : ScalarLanes<T> {};
+
+    template<>
+    struct NoiseLanes<double> {
+        using reg = __m256d;
+        using ireg = __m128i;
+        static constexpr std::size_t size = 4;
+
+        static inline reg load(const double* from) noexcept { return _mm256_loadu_pd(from); }
+        static inline void store(double* to, reg value) noexcept { _mm256_storeu_pd(to, value); }
+        static inline reg set1(double value) noexcept { return _mm256_set1_pd(value); }
+        static inline reg add(reg a, reg b) noexcept { return _mm256_add_pd(a, b); }
+        static inline reg sub(reg a, reg b) noexcept { return _mm256_sub_pd(a, b); }
+        static inline reg mul(reg a, reg b) noexcept { return _mm256_mul_pd(a, b); }
+        static inline reg floor(reg a) noexcept { return _mm256_floor_pd(a); }
+
+        static inline ireg cells(reg floored) noexcept { return _mm_and_si128(_mm256_cvttpd_epi32(floored), _mm_set1_epi32(255)); }
+        static inline ireg iadd(ireg a, ireg b) noexcept { return _mm_add_epi32(a, b); }
+        static inline ireg iset1(std::int32_t value) noexcept { return _mm_set1_epi32(value); }
+        static inline ireg gather(const std::int32_t* table, ireg index) noexcept { return _mm_i32gather_epi32(table, index, 4); }
+
+        // the masked gather, the plain one trips -Wmaybe-uninitialized on GCC 12
+        static inline reg gather_grad(const double* table, ireg hash) noexcept {
+            const __m256d all = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+            return _mm256_mask_i32gather_pd(_mm256_setzero_pd(), table, _mm_and_si128(hash, _mm_set1_epi32(15)), all, 8);
+        }
+    };
+
+    template<>
+    struct NoiseLanes<float> {
+        using reg = __m256;
+        using ireg = __m256i;
+        static constexpr std::size_t size = 8;
+
+        static inline reg load(const float* from) noexcept { return _mm256_loadu_ps(from); }
+        static inline void store(float* to, reg value) noexcept { _mm256_storeu_ps(to, value); }
+        static inline reg set1(float value) noexcept { return _mm256_set1_ps(value); }
+        static inline reg add(reg a, reg b) noexcept { return _mm256_add_ps(a, b); }
+        static inline reg sub(reg a, reg b) noexcept { return _mm256_sub_ps(a, b); }
+        static inline reg mul(reg a, reg b) noexcept { return _mm256_mul_ps(a, b); }
+        static inline reg floor(reg a) noexcept { return _mm256_floor_ps(a); }
+
+        static inline ireg cells(reg floored) noexcept { return _mm256_and_si256(_mm256_cvttps_epi32(floored), _mm256_set1_epi32(255)); }
+        static inline ireg iadd(ireg a, ireg b) noexcept { return _mm256_add_epi32(a, b); }
+        static inline ireg iset1(std::int32_t value) noexcept { return _mm256_set1_epi32(value); }
+        static inline ireg gather(const std::int32_t* table, ireg index) noexcept { return _mm256_i32gather_epi32(table, index, 4); }
+
+        static inline reg gather_grad(const float* table, ireg hash) noexcept {
+            const __m256 all = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+            return _mm256_mask_i32gather_ps(_mm256_setzero_ps(), table, _mm256_and_si256(hash, _mm256_set1_epi32(15)), all, 4);
+        }
+    };
+#elif defined(BOAR_SIMD_SSE2)
+    // SSE2 has no gathers, the integer side is done per lane
+    template<typename T, std::size_t Size>
+    struct SSE2IntLanes {
+        using ireg = std::array<std::int32_t, Size>;
+
+        static inline ireg iadd(ireg a, ireg b) noexcept {
+            for (std::size_t i = 0; i < Size; i++) a[i] += b[i];
+            return a;
+        }
+
+        static inline ireg iset1(std::int32_t value) noexcept {
+            ireg result;
+            result.fill(value);
+            return result;
+        }
+
+        static inline ireg gather(const std::int32_t* table, ireg index) noexcept {
+            for (std::size_t i = 0; i < Size; i++) index[i] = table[index[i]];
+            return index;
+        }
+
+        static inline ireg cells(const std::array<T, Size>& floored) noexcept {
+            ireg result;
+            for (std::size_t i = 0; i < Size; i++) result[i] = static_cast<std::int32_t>(floored[i]) & 255;
+            return result;
+        }
+    };
+
+    template<typename T>
+    struct NoiseLanes : ScalarLanes<T> {};
+
+    template<>
+    struct NoiseLanes<double> : SSE2IntLanes<double, 2> {
+        using reg = __m128d;
+        static constexpr std::size_t size = 2;
+
+        static inline reg load(const double* from) noexcept { return _mm_loadu_pd(from); }
+        static inline void store(double* to, reg value) noexcept { _mm_storeu_pd(to, value); }
+        static inline reg set1(double value) noexcept { return _mm_set1_pd(value); }
+        static inline reg add(reg a, reg b) noexcept { return _mm_add_pd(a, b); }
+        static inline reg sub(reg a, reg b) noexcept { return _mm_sub_pd(a, b); }
+        static inline reg mul(reg a, reg b) noexcept { return _mm_mul_pd(a, b); }
+
+        // truncate and step down where that rounded up
+        static inline reg floor(reg a) noexcept {
+            const __m128d truncated = _mm_cvtepi32_pd(_mm_cvttpd_epi32(a));
+            return _mm_sub_pd(truncated, _mm_and_pd(_mm_cmplt_pd(a, truncated), _mm_set1_pd(1)));
+        }
+
+        static inline ireg cells(reg floored) noexcept {
+            std::array<double, 2> values;
+            _mm_storeu_pd(values.data(), floored);
+            return SSE2IntLanes::cells(values);
+        }
+
+        static inline reg gather_grad(const double* table, const ireg& hash) noexcept {
+            return _mm_set_pd(table[hash[1] & 15], table[hash[0] & 15]);
+        }
+    };
+
+    template<>
+    struct NoiseLanes<float> : SSE2IntLanes<float, 4> {
+        using reg = __m128;
+        static constexpr std::size_t size = 4;
+
+        static inline reg load(const float* from) noexcept { return _mm_loadu_ps(from); }
+        static inline void store(float* to, reg value) noexcept { _mm_storeu_ps(to, value); }
+        static inline reg set1(float value) noexcept { return _mm_set1_ps(value); }
+        static inline reg add(reg a, reg b) noexcept { return _mm_add_ps(a, b); }
+        static inline reg sub(reg a, reg b) noexcept { return _mm_sub_ps(a, b); }
+        static inline reg mul(reg a, reg b) noexcept { return _mm_mul_ps(a, b); }
+
+        static inline reg floor(reg a) noexcept {
+            const __m128 truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(a));
+            return _mm_sub_ps(truncated, _mm_and_ps(_mm_cmplt_ps(a, truncated), _mm_set1_ps(1)));
+        }
+
+        static inline ireg cells(reg floored) noexcept {
+            std::array<float, 4> values;
+            _mm_storeu_ps(values.data(), floored);
+            return SSE2IntLanes::cells(values);
+        }
+
+        static inline reg gather_grad(const float* table, const ireg& hash) noexcept {
+            return _mm_setr_ps(table[hash[0] & 15], table[hash[1] & 15], table[hash[2] & 15], table[hash[3] & 15]);
+        }
+    };
+#else
+    template<typename T>
+    struct NoiseLanes : ScalarLanes<T> {};
+#endif
+
+
+    // Seeding, serialization and the octave interfaces the noise engines
+    // share, so one can be swapped for another. Derived provides
+    // raw_noise(x, y) and raw_noise(x, y, z)
+    template<typename Derived, typename T>
+    class Basic_NoiseEngine {
+
+        protected:
+
+            std::array<uint8_t, 512> p;
+            // p widened for gathers
+            std::array<std::int32_t, 512> p32;
+            T octave_bias = 2;
+
+            Basic_NoiseEngine(uint32_t seed) {
+                this->reseed(seed);
+            }
+
+        public:
+
+            using value_type = T;
+
+            void reseed(uint32_t seed) {
+
+                for (uint16_t i = 0; i < 256; ++i) {
+                    this->p[i] = static_cast<uint8_t>(i);
+                }
+
+                std::shuffle(std::begin(this->p), std::begin(this->p) + 256, std::default_random_engine(seed));
+
+                for (uint16_t i = 0; i < 256; ++i) {
+                    this->p[256 + i] = this->p[i];
+                }
+                this->widen();
+            }
+
+        protected:
+
+            [[nodiscard]]
+            static constexpr T weight(const std::int32_t octaves) noexcept {
+                
+                T value = 0;
+                T amplitude = 1;
+
+                for (std::int32_t i = 0; i < octaves; ++i) {
+                    value += amplitude;
+                    amplitude /= 2;
+                }
+
+                return value;
+            }
+
+        public:
+
+            // ############################################################################
+            // #                                                                          #
+            // #                               interfaces                                 #
+            // #                                                                          #
+            // ############################################################################
+
+            [[nodiscard]]
+            T noise1D(T x, const T octv, const T freq, T ampl) const noexcept {
+                
+                x = x / freq;
+                T result = 0;
+                T amp = 1;
+                for (std::int32_t i = 0; i < octv; ++i) {
+                    result += this->derived().raw_noise(x, 0) * amp;
+                    x *= octave_bias;
+                    amp /= octave_bias;
+                }
+
+                return (result / this->weight(octv)) * ampl;
+            }
+            
+            [[nodiscard]]
+            T noise2D(T x, T y, const T octv, const T freq, T ampl) const noexcept {
+                
+                x = x / freq;
+                y = y / freq;
+                T result = 0;
+                T amp = 1;
+                for (std::int32_t i = 0; i < octv; ++i) {
+                    result += this->derived().raw_noise(x, y) * amp;
+                    x *= octave_bias;
+                    y *= octave_bias;
+                    amp /= octave_bias;
+                }
+
+                return (result / this->weight(octv)) * ampl;
+            }
+            
+            [[nodiscard]]
+            T noise3D(T x, T y, T z, const T octv, const T freq, T ampl) const noexcept {
+                
+                x = x / freq;
+                y = y / freq;
+                z = z / freq;
+                T result = 0;
+                T amp = 1;
+                for (std::int32_t i = 0; i < octv; ++i) {
+                    result += this->derived().raw_noise(x, y, z) * amp;
+                    x *= octave_bias;
+                    y *= octave_bias;
+                    z *= octave_bias;
+                    amp /= octave_bias;
+                }
+
+                return (result / this->weight(octv)) * ampl;
+            }
+
+            // Fixed octave count versions, noise2D<4>(x, y, freq, ampl). The
+            // normalization weight is a constant and the octave loop unrolls
+            template<std::int32_t Octaves>
+            [[nodiscard]]
+            T noise1D(T x, const T freq, T ampl) const noexcept {
+
+                static_assert(Octaves > 0, "at least one octave");
+                constexpr T WEIGHT = weight(Octaves);
+
+                x = x / freq;
+                T result = 0;
+                T amp = 1;
+                for (std::int32_t i = 0; i < Octaves; ++i) {
+                    result += this->derived().raw_noise(x, 0) * amp;
+                    x *= octave_bias;
+                    amp /= octave_bias;
+                }
+
+                return (result / WEIGHT) * ampl;
+            }
+
+            template<std::int32_t Octaves>
+            [[nodiscard]]
+            T noise2D(T x, T y, const T freq, T ampl) const noexcept {
+
+                static_assert(Octaves > 0, "at least one octave");
+                constexpr T WEIGHT = weight(Octaves);
+
+                x = x / freq;
+                y = y / freq;
+                T result = 0;
+                T amp = 1;
+                for (std::int32_t i = 0; i < Octaves; ++i) {
+                    result += this->derived().raw_noise(x, y) * amp;
+                    x *= octave_bias;
+                    y *= octave_bias;
+                    amp /= octave_bias;
+                }
+
+                return (result / WEIGHT) * ampl;
+            }
+
+            template<std::int32_t Octaves>
+            [[nodiscard]]
+            T noise3D(T x, T y, T z, const T freq, T ampl) const noexcept {
+
+                static_assert(Octaves > 0, "at least one octave");
+                constexpr T WEIGHT = weight(Octaves);
+
+                x = x / freq;
+                y = y / freq;
+                z = z / freq;
+                T result = 0;
+                T amp = 1;
+                for (std::int32_t i = 0; i < Octaves; ++i) {
+                    result += this->derived().raw_noise(x, y, z) * amp;
+                    x *= octave_bias;
+                    y *= octave_bias;
+                    z *= octave_bias;
+                    amp /= octave_bias;
+                }
+
+                return (result / WEIGHT) * ampl;
+            }
+
+
+            // ############################################################################ 
+            // #                                                                          #
+            // #                                   I/O                                    #
+            // #                                                                          #
+            // ############################################################################
+
+
+            void serialize(std::array<std::uint8_t, 256>& s) const noexcept {
+                for (std::size_t i = 0; i < 256; ++i)
+                {
+                    s[i] = this->p[i];
+                }
+            }
+
+            void deserialize(const std::array<std::uint8_t, 256>& s) noexcept {
+                for (std::size_t i = 0; i < 256; ++i)
+                {
+                    this->p[256 + i] = this->p[i] = s[i];
+                }
+                this->widen();
+            }
+
+        private:
+
+            [[nodiscard]]
+            inline const Derived& derived() const noexcept {
+                return static_cast<const Derived&>(*this);
+            }
+
+            void widen() noexcept {
+                std::copy(this->p.begin(), this->p.end(), this->p32.begin());
+            }
+
+    };
+
+
+    // Perlin noise in T precision, PerlinNoise is the double one. float
+    // halves heightmap memory and doubles the SIMD lanes of the batch calls
+    template<typename T>
+    class Basic_PerlinNoise : public Basic_NoiseEngine<Basic_PerlinNoise<T>, T> {
+
+        using Base = Basic_NoiseEngine<Basic_PerlinNoise<T>, T>;
+
+        // all of Perlin Noise core math was based on https://github.com/Reputeless/PerlinNoise
+
+        private:
+
+            // grad() as (x, y, z) coefficients for each hash & 15
+            static constexpr std::array<T, 16> GRAD_X {1, -1, 1, -1, 1, -1, 1, -1, 0, 0, 0, 0, 1, 0, -1, 0};
+            static constexpr std::array<T, 16> GRAD_Y {1, 1, -1, -1, 0, 0, 0, 0, 1, -1, 1, -1, 1, -1, 1, -1};
+            static constexpr std::array<T, 16> GRAD_Z {0, 0, 0, 0, 1, 1, -1, -1, 1, 1, -1, -1, 0, 1, 0, -1};
+
+        public:
+
+            Basic_PerlinNoise(uint32_t seed = 0) : Base(seed) {}
+
+            using Base::noise1D;
+            using Base::noise2D;
+            using Base::noise3D;
+
+            // The octave interfaces of Basic_NoiseEngine, with the octaves of
+            // the one point evaluated side by side in the SIMD lanes once
+            // there are enough of them to fill the lanes. The results are
+            // the base's to the bit, the octaves are summed in the same order
+            [[nodiscard]]
+            T noise1D(T x, const T octv, const T freq, T ampl) const noexcept {
+                const std::int32_t octaves = lane_octaves(octv);
+                if (octaves == 0) {
+                    return Base::noise1D(x, octv, freq, ampl);
+                }
+                return (this->octave_sum<false>(x / freq, 0, 0, octaves) / this->weight(octv)) * ampl;
+            }
+
+            [[nodiscard]]
+            T noise2D(T x, T y, const T octv, const T freq, T ampl) const noexcept {
+                const std::int32_t octaves = lane_octaves(octv);
+                if (octaves == 0) {
+                    return Base::noise2D(x, y, octv, freq, ampl);
+                }
+                return (this->octave_sum<false>(x / freq, y / freq, 0, octaves) / this->weight(octv)) * ampl;
+            }
+
+            [[nodiscard]]
+            T noise3D(T x, T y, T z, const T octv, const T freq, T ampl) const noexcept {
+                const std::int32_t octaves = lane_octaves(octv);
+                if (octaves == 0) {
+                    return Base::noise3D(x, y, z, octv, freq, ampl);
+                }
+                return (this->octave_sum<true>(x / freq, y / freq, z / freq, octaves) / this->weight(octv)) * ampl;
+            }
+
+            template<std::int32_t Octaves>
+            [[nodiscard]]
+            T noise1D(T x, const T freq, T ampl) const noexcept {
+                if constexpr (fills_lanes(Octaves)) {
+                    constexpr T WEIGHT = Base::weight(Octaves);
+                    return (this->octave_sum<false>(x / freq, 0, 0, Octaves) / WEIGHT) * ampl;
+                }
+                else {
+                    return Base::template noise1D<Octaves>(x, freq, ampl);
+                }
+            }
+
+            template<std::int32_t Octaves>
+            [[nodiscard]]
+            T noise2D(T x, T y, const T freq, T ampl) const noexcept {
+                if constexpr (fills_lanes(Octaves)) {
+                    constexpr T WEIGHT = Base::weight(Octaves);
+                    return (this->octave_sum<false>(x / freq, y / freq, 0, Octaves) / WEIGHT) * ampl;
+                }
+                else {
+                    return Base::template noise2D<Octaves>(x, y, freq, ampl);
+                }
+            }
+
+            template<std::int32_t Octaves>
+            [[nodiscard]]
+            T noise3D(T x, T y, T z, const T freq, T ampl) const noexcept {
+                if constexpr (fills_lanes(Octaves)) {
+                    constexpr T WEIGHT = Base::weight(Octaves);
+                    return (this->octave_sum<true>(x / freq, y / freq, z / freq, Octaves) / WEIGHT) * ampl;
+                }
+                else {
+                    return Base::template noise3D<Octaves>(x, y, z, freq, ampl);
+                }
+            }
+
+        private:
+
+            // at most this many octaves go through the lanes, more run the
+            // base's loop
+            static constexpr std::int32_t MAX_LANE_OCTAVES = 32;
+
+            [[nodiscard]]
+            static constexpr bool fills_lanes(const std::int32_t octaves) noexcept {
+                return NoiseLanes<T>::size > 1 && octaves >= static_cast<std::int32_t>(NoiseLanes<T>::size) &&
+                       octaves <= MAX_LANE_OCTAVES;
+            }
+
+            // How many octaves the base's loop runs for octv, 0 when that
+            // does not fill the lanes
+            [[nodiscard]]
+            static std::int32_t lane_octaves(const T octv) noexcept {
+                std::int32_t octaves = 0;
+                while (octaves < octv && octaves <= MAX_LANE_OCTAVES) {
+                    ++octaves;
+                }
+                return fills_lanes(octaves) ? octaves : 0;
+            }
+
+            // The base's octave loop: raw_noise at the coordinates scaled by
+            // octave_bias per octave, weighted by 1 / octave_bias per octave
+            template<bool ThreeD>
+            [[nodiscard]]
+            T octave_sum(T x, T y, T z, const std::int32_t octaves) const noexcept {
+
+                std::array<T, MAX_LANE_OCTAVES> xs, ys, zs, values;
+                for (std::int32_t i = 0; i < octaves; ++i) {
+                    xs[i] = x;
+                    ys[i] = y;
+                    zs[i] = z;
+                    values[i] = 0;
+                    x *= this->octave_bias;
+                    y *= this->octave_bias;
+                    z *= this->octave_bias;
+                }
+
+                if constexpr (ThreeD) {
+                    this->raw_noise_3D(xs.data(), ys.data(), zs.data(), values.data(), octaves, 1);
+                }
+                else {
+                    this->raw_noise_2D(xs.data(), ys.data(), values.data(), octaves, 1);
+                }
+
+                T result = 0;
+                T amp = 1;
+                for (std::int32_t i = 0; i < octaves; ++i) {
+                    result += values[i] * amp;
+                    amp /= this->octave_bias;
+                }
+                return result;
+            }
+
+            // ############################################################################
+            // #                                                                          #
+            // #                               internals                                  #
+            // #                                                                          #
+            // ############################################################################
+
+            [[nodiscard]]
+            static constexpr T fade(const T t) noexcept {
+                
+                return t * t * t * (t * (t * 6 - 15) + 10);
+            }
+
+            [[nodiscard]]
+            static constexpr T lerp(const T t, const T a, const T b) noexcept {
+                
+                return a + t * (b - a);
+            }
+
+            [[nodiscard]]
+            static constexpr T grad(const std::uint8_t hash, const T x, const T y, const T z) noexcept {
+                
+                const std::uint8_t h = hash & 15;
+                const T u = h < 8 ? x : y;
+                const T v = h < 4 ? y : h == 12 || h == 14 ? x : z;
+                return ((h & 1) == 0 ? u : -u) + ((h & 2) == 0 ? v : -v);
+            }
+
+        public:
+
+            [[nodiscard]]
+            T raw_noise(T x = 0, T y = 0, T z = 0) const noexcept {
+                
+                const std::int32_t X = static_cast<std::int32_t>(std::floor(x)) & 255;
+                const std::int32_t Y = static_cast<std::int32_t>(std::floor(y)) & 255;
+                const std::int32_t Z = static_cast<std::int32_t>(std::floor(z)) & 255;
+
+                x -= std::floor(x);
+                y -= std::floor(y);
+                z -= std::floor(z);
+
+                const T u = this->fade(x);
+                const T v = this->fade(y);
+                const T w = this->fade(z);
+
+                const std::int32_t A = this->p[X] + Y, AA = this->p[A] + Z, AB = this->p[A + 1] + Z;
+                const std::int32_t B = this->p[X + 1] + Y, BA = this->p[B] + Z, BB = this->p[B + 1] + Z;
+
+                return this->lerp(
+                    w, 
                     this->lerp(
                         v, 
                         this->lerp(u, this->grad(this->p[AA], x, y, z),
@@ -430,100 +3778,1772 @@ namespace boar {
                             this->grad(this->p[BB], x - 1, y - 1, z)
                         )
                     ),
-                    this->lerp(v,
-                        this->lerp(u, 
-                            this->grad(this->p[AA + 1], x, y, z - 1),
-                            this->grad(this->p[BA + 1], x - 1, y, z - 1)
-                        ),
-                        this->lerp(u, 
-                            this->grad(this->p[AB + 1], x, y - 1, z - 1),
-                            this->grad(this->p[BB + 1], x - 1, y - 1, z - 1)
-                        )
-                    )
+                    this->lerp(v,
+                        this->lerp(u, 
+                            this->grad(this->p[AA + 1], x, y, z - 1),
+                            this->grad(this->p[BA + 1], x - 1, y, z - 1)
+                        ),
+                        this->lerp(u, 
+                            this->grad(this->p[AB + 1], x, y - 1, z - 1),
+                            this->grad(this->p[BB + 1], x - 1, y - 1, z - 1)
+                        )
+                    )
+                );
+            }
+        
+            
+            // Batch versions of the interfaces above, out[i] gets the noise at
+            // (x[i], y[i], z[i]). Several points go through the SIMD lanes at once
+            void noise1D(const T* x, T* out, std::size_t count, const T octv, const T freq, T ampl) const noexcept {
+                this->batch(x, nullptr, nullptr, out, count, octv, freq, ampl);
+            }
+
+            void noise2D(const T* x, const T* y, T* out, std::size_t count,
+                         const T octv, const T freq, T ampl) const noexcept {
+                this->batch(x, y, nullptr, out, count, octv, freq, ampl);
+            }
+
+            void noise3D(const T* x, const T* y, const T* z, T* out, std::size_t count,
+                         const T octv, const T freq, T ampl) const noexcept {
+                this->batch(x, y, z, out, count, octv, freq, ampl);
+            }
+
+        private:
+
+            // Runs the octave loop of the interfaces over chunks of points,
+            // a missing y or z reads as 0
+            void batch(const T* x, const T* y, const T* z, T* out, std::size_t count,
+                       const T octv, const T freq, T ampl) const noexcept {
+
+                constexpr std::size_t CHUNK = 256;
+                std::array<T, CHUNK> xs, ys, zs;
+                const T factor = ampl / this->weight(octv);
+
+                for (std::size_t begin = 0; begin < count; begin += CHUNK) {
+
+                    const std::size_t size = std::min(CHUNK, count - begin);
+                    for (std::size_t i = 0; i < size; i++) {
+                        xs[i] = x[begin + i] / freq;
+                        ys[i] = y ? y[begin + i] / freq : 0;
+                        zs[i] = z ? z[begin + i] / freq : 0;
+                    }
+
+                    T* result = out + begin;
+                    std::fill(result, result + size, T(0));
+
+                    T amp = 1;
+                    for (std::int32_t i = 0; i < octv; ++i) {
+                        if (z) {
+                            this->raw_noise_3D(xs.data(), ys.data(), zs.data(), result, size, amp);
+                        }
+                        else {
+                            this->raw_noise_2D(xs.data(), ys.data(), result, size, amp);
+                        }
+                        for (std::size_t j = 0; j < size; j++) {
+                            xs[j] *= this->octave_bias;
+                            ys[j] *= this->octave_bias;
+                            zs[j] *= this->octave_bias;
+                        }
+                        amp /= this->octave_bias;
+                    }
+
+                    for (std::size_t i = 0; i < size; i++) {
+                        result[i] *= factor;
+                    }
+                }
+            }
+
+            // ############################################################################
+            // #                                                                          #
+            // #                              SIMD kernels                                #
+            // #                                                                          #
+            // ############################################################################
+
+            // out[i] += raw_noise(x[i], y[i], 0) * amp, the z = 0 half that
+            // raw_noise interpolates away is skipped
+            void raw_noise_2D(const T* x, const T* y, T* out, std::size_t count, T amp) const noexcept {
+                const std::size_t done = this->raw_noise_2D<NoiseLanes<T>>(x, y, out, count, amp, 0);
+                this->raw_noise_2D<ScalarLanes<T>>(x, y, out, count, amp, done);
+            }
+
+            // out[i] += raw_noise(x[i], y[i], z[i]) * amp
+            void raw_noise_3D(const T* x, const T* y, const T* z, T* out, std::size_t count, T amp) const noexcept {
+                const std::size_t done = this->raw_noise_3D<NoiseLanes<T>>(x, y, z, out, count, amp, 0);
+                this->raw_noise_3D<ScalarLanes<T>>(x, y, z, out, count, amp, done);
+            }
+
+            // Runs Lanes::size points at a time from i on, returns where it stopped
+            template<typename Lanes>
+            std::size_t raw_noise_2D(const T* x, const T* y, T* out, std::size_t count, T amp, std::size_t i) const noexcept {
+
+                using reg = typename Lanes::reg;
+                using ireg = typename Lanes::ireg;
+
+                const reg amps = Lanes::set1(amp);
+                const reg ones = Lanes::set1(1);
+                const ireg one = Lanes::iset1(1);
+                const std::int32_t* perm = this->p32.data();
+
+                for (; i + Lanes::size <= count; i += Lanes::size) {
+
+                    reg px = Lanes::load(x + i);
+                    reg py = Lanes::load(y + i);
+                    const reg fx = Lanes::floor(px);
+                    const reg fy = Lanes::floor(py);
+                    const ireg X = Lanes::cells(fx);
+                    const ireg Y = Lanes::cells(fy);
+                    px = Lanes::sub(px, fx);
+                    py = Lanes::sub(py, fy);
+
+                    const reg u = lanes_fade<Lanes>(px);
+                    const reg v = lanes_fade<Lanes>(py);
+
+                    const ireg A = Lanes::iadd(Lanes::gather(perm, X), Y);
+                    const ireg B = Lanes::iadd(Lanes::gather(perm, Lanes::iadd(X, one)), Y);
+
+                    const reg px1 = Lanes::sub(px, ones);
+                    const reg py1 = Lanes::sub(py, ones);
+
+                    const reg value = lanes_lerp<Lanes>(v,
+                        lanes_lerp<Lanes>(u,
+                            lanes_grad<Lanes>(Lanes::gather(perm, Lanes::gather(perm, A)), px, py),
+                            lanes_grad<Lanes>(Lanes::gather(perm, Lanes::gather(perm, B)), px1, py)),
+                        lanes_lerp<Lanes>(u,
+                            lanes_grad<Lanes>(Lanes::gather(perm, Lanes::gather(perm, Lanes::iadd(A, one))), px, py1),
+                            lanes_grad<Lanes>(Lanes::gather(perm, Lanes::gather(perm, Lanes::iadd(B, one))), px1, py1))
+                    );
+                    Lanes::store(out + i, Lanes::add(Lanes::load(out + i), Lanes::mul(value, amps)));
+                }
+                return i;
+            }
+
+            template<typename Lanes>
+            std::size_t raw_noise_3D(const T* x, const T* y, const T* z, T* out, std::size_t count, T amp, std::size_t i) const noexcept {
+
+                using reg = typename Lanes::reg;
+                using ireg = typename Lanes::ireg;
+
+                const reg amps = Lanes::set1(amp);
+                const reg ones = Lanes::set1(1);
+                const ireg one = Lanes::iset1(1);
+                const std::int32_t* perm = this->p32.data();
+
+                for (; i + Lanes::size <= count; i += Lanes::size) {
+
+                    reg px = Lanes::load(x + i);
+                    reg py = Lanes::load(y + i);
+                    reg pz = Lanes::load(z + i);
+                    const reg fx = Lanes::floor(px);
+                    const reg fy = Lanes::floor(py);
+                    const reg fz = Lanes::floor(pz);
+                    const ireg X = Lanes::cells(fx);
+                    const ireg Y = Lanes::cells(fy);
+                    const ireg Z = Lanes::cells(fz);
+                    px = Lanes::sub(px, fx);
+                    py = Lanes::sub(py, fy);
+                    pz = Lanes::sub(pz, fz);
+
+                    const reg u = lanes_fade<Lanes>(px);
+                    const reg v = lanes_fade<Lanes>(py);
+                    const reg w = lanes_fade<Lanes>(pz);
+
+                    const ireg A = Lanes::iadd(Lanes::gather(perm, X), Y);
+                    const ireg B = Lanes::iadd(Lanes::gather(perm, Lanes::iadd(X, one)), Y);
+                    const ireg AA = Lanes::iadd(Lanes::gather(perm, A), Z);
+                    const ireg AB = Lanes::iadd(Lanes::gather(perm, Lanes::iadd(A, one)), Z);
+                    const ireg BA = Lanes::iadd(Lanes::gather(perm, B), Z);
+                    const ireg BB = Lanes::iadd(Lanes::gather(perm, Lanes::iadd(B, one)), Z);
+
+                    const reg px1 = Lanes::sub(px, ones);
+                    const reg py1 = Lanes::sub(py, ones);
+                    const reg pz1 = Lanes::sub(pz, ones);
+
+                    const reg value = lanes_lerp<Lanes>(w,
+                        lanes_lerp<Lanes>(v,
+                            lanes_lerp<Lanes>(u,
+                                lanes_grad<Lanes>(Lanes::gather(perm, AA), px, py, pz),
+                                lanes_grad<Lanes>(Lanes::gather(perm, BA), px1, py, pz)),
+                            lanes_lerp<Lanes>(u,
+                                lanes_grad<Lanes>(Lanes::gather(perm, AB), px, py1, pz),
+                                lanes_grad<Lanes>(Lanes::gather(perm, BB), px1, py1, pz))
+                        ),
+                        lanes_lerp<Lanes>(v,
+                            lanes_lerp<Lanes>(u,
+                                lanes_grad<Lanes>(Lanes::gather(perm, Lanes::iadd(AA, one)), px, py, pz1),
+                                lanes_grad<Lanes>(Lanes::gather(perm, Lanes::iadd(BA, one)), px1, py, pz1)),
+                            lanes_lerp<Lanes>(u,
+                                lanes_grad<Lanes>(Lanes::gather(perm, Lanes::iadd(AB, one)), px, py1, pz1),
+                                lanes_grad<Lanes>(Lanes::gather(perm, Lanes::iadd(BB, one)), px1, py1, pz1))
+                        )
+                    );
+                    Lanes::store(out + i, Lanes::add(Lanes::load(out + i), Lanes::mul(value, amps)));
+                }
+                return i;
+            }
+
+            // fade(), lerp() and grad() on lanes, same operation order as the scalar ones
+            template<typename Lanes>
+            static inline typename Lanes::reg lanes_fade(typename Lanes::reg t) noexcept {
+                const typename Lanes::reg inner = Lanes::add(Lanes::mul(t, Lanes::sub(Lanes::mul(t, Lanes::set1(6)), Lanes::set1(15))), Lanes::set1(10));
+                return Lanes::mul(Lanes::mul(Lanes::mul(t, t), t), inner);
+            }
+
+            template<typename Lanes>
+            static inline typename Lanes::reg lanes_lerp(typename Lanes::reg t, typename Lanes::reg a, typename Lanes::reg b) noexcept {
+                return Lanes::add(a, Lanes::mul(t, Lanes::sub(b, a)));
+            }
+
+            template<typename Lanes>
+            static inline typename Lanes::reg lanes_grad(const typename Lanes::ireg& hash, typename Lanes::reg x, typename Lanes::reg y) noexcept {
+                return Lanes::add(Lanes::mul(Lanes::gather_grad(GRAD_X.data(), hash), x),
+                                  Lanes::mul(Lanes::gather_grad(GRAD_Y.data(), hash), y));
+            }
+
+            template<typename Lanes>
+            static inline typename Lanes::reg lanes_grad(const typename Lanes::ireg& hash, typename Lanes::reg x, typename Lanes::reg y,
+                                                         typename Lanes::reg z) noexcept {
+                return Lanes::add(lanes_grad<Lanes>(hash, x, y), Lanes::mul(Lanes::gather_grad(GRAD_Z.data(), hash), z));
+            }
+
+        public:
+
+            // ############################################################################
+            // #                                                                          #
+            // #                               derivatives                                #
+            // #                                                                          #
+            // ############################################################################
+
+            // A noise value with its gradient, for normals and slopes without
+            // finite differences
+            struct Derivatives2D {
+                T value = 0;
+                T dx = 0;
+                T dy = 0;
+            };
+
+            struct Derivatives3D {
+                T value = 0;
+                T dx = 0;
+                T dy = 0;
+                T dz = 0;
+            };
+
+            // raw_noise(x, y, 0) and its partial derivatives in x and y. value
+            // is the same as raw_noise's
+            [[nodiscard]]
+            Derivatives2D raw_noise_derivatives(T x, T y) const noexcept {
+
+                const std::int32_t X = static_cast<std::int32_t>(std::floor(x)) & 255;
+                const std::int32_t Y = static_cast<std::int32_t>(std::floor(y)) & 255;
+
+                x -= std::floor(x);
+                y -= std::floor(y);
+
+                const T u = this->fade(x), du = this->fade_derivative(x);
+                const T v = this->fade(y), dv = this->fade_derivative(y);
+
+                const std::int32_t A = this->p[X] + Y, B = this->p[X + 1] + Y;
+                const std::uint8_t h00 = this->p[this->p[A]], h10 = this->p[this->p[B]];
+                const std::uint8_t h01 = this->p[this->p[A + 1]], h11 = this->p[this->p[B + 1]];
+
+                const T a = this->grad(h00, x, y, 0), b = this->grad(h10, x - 1, y, 0);
+                const T c = this->grad(h01, x, y - 1, 0), d = this->grad(h11, x - 1, y - 1, 0);
+
+                // the corner values vary with the point through their gradients
+                const auto blend = [&](const std::array<T, 16>& g) {
+                    return this->lerp(v, this->lerp(u, g[h00 & 15], g[h10 & 15]), this->lerp(u, g[h01 & 15], g[h11 & 15]));
+                };
+
+                return {
+                    this->lerp(v, this->lerp(u, a, b), this->lerp(u, c, d)),
+                    du * ((b - a) + (a - b - c + d) * v) + blend(GRAD_X),
+                    dv * ((c - a) + (a - b - c + d) * u) + blend(GRAD_Y)
+                };
+            }
+
+            // raw_noise(x, y, z) and its partial derivatives
+            [[nodiscard]]
+            Derivatives3D raw_noise_derivatives(T x, T y, T z) const noexcept {
+
+                const std::int32_t X = static_cast<std::int32_t>(std::floor(x)) & 255;
+                const std::int32_t Y = static_cast<std::int32_t>(std::floor(y)) & 255;
+                const std::int32_t Z = static_cast<std::int32_t>(std::floor(z)) & 255;
+
+                x -= std::floor(x);
+                y -= std::floor(y);
+                z -= std::floor(z);
+
+                const T u = this->fade(x), du = this->fade_derivative(x);
+                const T v = this->fade(y), dv = this->fade_derivative(y);
+                const T w = this->fade(z), dw = this->fade_derivative(z);
+
+                const std::int32_t A = this->p[X] + Y, AA = this->p[A] + Z, AB = this->p[A + 1] + Z;
+                const std::int32_t B = this->p[X + 1] + Y, BA = this->p[B] + Z, BB = this->p[B + 1] + Z;
+
+                // corners in x, y, z bit order
+                const std::array<std::uint8_t, 8> h {
+                    this->p[AA], this->p[BA], this->p[AB], this->p[BB],
+                    this->p[AA + 1], this->p[BA + 1], this->p[AB + 1], this->p[BB + 1]
+                };
+                const std::array<T, 8> g {
+                    this->grad(h[0], x, y, z), this->grad(h[1], x - 1, y, z),
+                    this->grad(h[2], x, y - 1, z), this->grad(h[3], x - 1, y - 1, z),
+                    this->grad(h[4], x, y, z - 1), this->grad(h[5], x - 1, y, z - 1),
+                    this->grad(h[6], x, y - 1, z - 1), this->grad(h[7], x - 1, y - 1, z - 1)
+                };
+
+                const auto blend = [&](const std::array<T, 16>& table) {
+                    return this->lerp(w,
+                        this->lerp(v, this->lerp(u, table[h[0] & 15], table[h[1] & 15]), this->lerp(u, table[h[2] & 15], table[h[3] & 15])),
+                        this->lerp(v, this->lerp(u, table[h[4] & 15], table[h[5] & 15]), this->lerp(u, table[h[6] & 15], table[h[7] & 15]))
+                    );
+                };
+
+                // the trilinear blend as k0 + k1 u + k2 v + k3 w + k4 uv + k5 vw + k6 wu + k7 uvw
+                const T k1 = g[1] - g[0];
+                const T k2 = g[2] - g[0];
+                const T k3 = g[4] - g[0];
+                const T k4 = g[0] - g[1] - g[2] + g[3];
+                const T k5 = g[0] - g[2] - g[4] + g[6];
+                const T k6 = g[0] - g[1] - g[4] + g[5];
+                const T k7 = -g[0] + g[1] + g[2] - g[3] + g[4] - g[5] - g[6] + g[7];
+
+                return {
+                    this->lerp(w,
+                        this->lerp(v, this->lerp(u, g[0], g[1]), this->lerp(u, g[2], g[3])),
+                        this->lerp(v, this->lerp(u, g[4], g[5]), this->lerp(u, g[6], g[7]))
+                    ),
+                    du * (k1 + k4 * v + k6 * w + k7 * v * w) + blend(GRAD_X),
+                    dv * (k2 + k4 * u + k5 * w + k7 * u * w) + blend(GRAD_Y),
+                    dw * (k3 + k5 * v + k6 * u + k7 * u * v) + blend(GRAD_Z)
+                };
+            }
+
+            // noise2D and its gradient in world units from one walk of the
+            // octaves, value is the same as noise2D's
+            [[nodiscard]]
+            Derivatives2D noise2D_derivatives(T x, T y, const T octv, const T freq, T ampl) const noexcept {
+
+                x = x / freq;
+                y = y / freq;
+                Derivatives2D result;
+                T amp = 1;
+                T scale = 1 / freq;
+                for (std::int32_t i = 0; i < octv; ++i) {
+                    const Derivatives2D octave = this->raw_noise_derivatives(x, y);
+                    result.value += octave.value * amp;
+                    result.dx += octave.dx * amp * scale;
+                    result.dy += octave.dy * amp * scale;
+                    x *= this->octave_bias;
+                    y *= this->octave_bias;
+                    amp /= this->octave_bias;
+                    scale *= this->octave_bias;
+                }
+
+                const T weight = this->weight(octv);
+                return {(result.value / weight) * ampl, (result.dx / weight) * ampl, (result.dy / weight) * ampl};
+            }
+
+            [[nodiscard]]
+            Derivatives3D noise3D_derivatives(T x, T y, T z, const T octv, const T freq, T ampl) const noexcept {
+
+                x = x / freq;
+                y = y / freq;
+                z = z / freq;
+                Derivatives3D result;
+                T amp = 1;
+                T scale = 1 / freq;
+                for (std::int32_t i = 0; i < octv; ++i) {
+                    const Derivatives3D octave = this->raw_noise_derivatives(x, y, z);
+                    result.value += octave.value * amp;
+                    result.dx += octave.dx * amp * scale;
+                    result.dy += octave.dy * amp * scale;
+                    result.dz += octave.dz * amp * scale;
+                    x *= this->octave_bias;
+                    y *= this->octave_bias;
+                    z *= this->octave_bias;
+                    amp /= this->octave_bias;
+                    scale *= this->octave_bias;
+                }
+
+                const T weight = this->weight(octv);
+                return {(result.value / weight) * ampl, (result.dx / weight) * ampl,
+                        (result.dy / weight) * ampl, (result.dz / weight) * ampl};
+            }
+
+            // fBm where each octave is damped by the slope summed so far, so
+            // detail settles in valleys and steep sides stay smooth, like
+            // eroded terrain. Inigo Quilez's derivative fBm
+            [[nodiscard]]
+            T eroded2D(T x, T y, const T octv, const T freq, T ampl) const noexcept {
+
+                x = x / freq;
+                y = y / freq;
+                T result = 0;
+                T amp = 1;
+                T dx = 0, dy = 0;
+                for (std::int32_t i = 0; i < octv; ++i) {
+                    const Derivatives2D octave = this->raw_noise_derivatives(x, y);
+                    dx += octave.dx;
+                    dy += octave.dy;
+                    result += amp * octave.value / (1 + dx * dx + dy * dy);
+                    x *= this->octave_bias;
+                    y *= this->octave_bias;
+                    amp /= this->octave_bias;
+                }
+
+                return (result / this->weight(octv)) * ampl;
+            }
+
+        private:
+
+            [[nodiscard]]
+            static constexpr T fade_derivative(const T t) noexcept {
+                return t * t * (t * (t * 30 - 60) + 30);
+            }
+
+        public:
+
+            // ############################################################################
+            // #                                                                          #
+            // #                               region fill                                #
+            // #                                                                          #
+            // ############################################################################
+
+            // noise2D over size_x by size_y samples step apart from (x, y),
+            // written row by row to out. The lattice cell of each column and
+            // row is worked out once per octave instead of once per sample
+            void fill2D(T* out, T x, T y, std::size_t size_x, std::size_t size_y, T step,
+                        const T octv, const T freq, T ampl) const {
+
+                std::fill(out, out + size_x * size_y, T(0));
+
+                vector<Lattice> columns(size_x);
+                T scale = 1 / freq;
+                T amp = 1;
+                for (std::int32_t i = 0; i < octv; ++i) {
+
+                    this->lattice(columns, x, step, scale);
+
+                    for (std::size_t j = 0; j < size_y; j++) {
+
+                        const Lattice row = this->lattice((y + j * step) * scale);
+                        T* line = out + j * size_x;
+
+                        // the four corner hashes only change with the column's cell
+                        std::int32_t cell = -1;
+                        std::uint8_t h00 = 0, h10 = 0, h01 = 0, h11 = 0;
+
+                        for (std::size_t k = 0; k < size_x; k++) {
+
+                            const Lattice& column = columns[k];
+                            if (column.cell != cell) {
+                                cell = column.cell;
+                                const std::int32_t A = this->p[cell] + row.cell;
+                                const std::int32_t B = this->p[cell + 1] + row.cell;
+                                h00 = this->p[this->p[A]];
+                                h01 = this->p[this->p[A + 1]];
+                                h10 = this->p[this->p[B]];
+                                h11 = this->p[this->p[B + 1]];
+                            }
+
+                            const T value = this->lerp(row.fade,
+                                this->lerp(column.fade, this->grad(h00, column.offset, row.offset, 0),
+                                                        this->grad(h10, column.offset - 1, row.offset, 0)),
+                                this->lerp(column.fade, this->grad(h01, column.offset, row.offset - 1, 0),
+                                                        this->grad(h11, column.offset - 1, row.offset - 1, 0))
+                            );
+                            line[k] += value * amp;
+                        }
+                    }
+
+                    scale *= this->octave_bias;
+                    amp /= this->octave_bias;
+                }
+
+                const T factor = ampl / this->weight(octv);
+                for (std::size_t i = 0; i < size_x * size_y; i++) {
+                    out[i] *= factor;
+                }
+            }
+
+            // noise3D over size_x by size_y by size_z samples step apart from
+            // (x, y, z), x fastest then y then z
+            void fill3D(T* out, T x, T y, T z, std::size_t size_x, std::size_t size_y, std::size_t size_z,
+                        T step, const T octv, const T freq, T ampl) const {
+
+                const std::size_t layer_size = size_x * size_y;
+                std::fill(out, out + layer_size * size_z, T(0));
+
+                vector<Lattice> columns(size_x);
+                vector<Lattice> rows(size_y);
+                T scale = 1 / freq;
+                T amp = 1;
+                for (std::int32_t i = 0; i < octv; ++i) {
+
+                    this->lattice(columns, x, step, scale);
+                    this->lattice(rows, y, step, scale);
+
+                    for (std::size_t l = 0; l < size_z; l++) {
+
+                        const Lattice layer = this->lattice((z + l * step) * scale);
+
+                        for (std::size_t j = 0; j < size_y; j++) {
+
+                            const Lattice& row = rows[j];
+                            T* line = out + l * layer_size + j * size_x;
+
+                            std::int32_t cell = -1;
+                            std::int32_t AA = 0, AB = 0, BA = 0, BB = 0;
+
+                            for (std::size_t k = 0; k < size_x; k++) {
+
+                                const Lattice& column = columns[k];
+                                if (column.cell != cell) {
+                                    cell = column.cell;
+                                    const std::int32_t A = this->p[cell] + row.cell;
+                                    const std::int32_t B = this->p[cell + 1] + row.cell;
+                                    AA = this->p[A] + layer.cell;
+                                    AB = this->p[A + 1] + layer.cell;
+                                    BA = this->p[B] + layer.cell;
+                                    BB = this->p[B + 1] + layer.cell;
+                                }
+
+                                const T fx = column.offset, fy = row.offset, fz = layer.offset;
+                                const T value = this->lerp(layer.fade,
+                                    this->lerp(row.fade,
+                                        this->lerp(column.fade, this->grad(this->p[AA], fx, fy, fz),
+                                                                this->grad(this->p[BA], fx - 1, fy, fz)),
+                                        this->lerp(column.fade, this->grad(this->p[AB], fx, fy - 1, fz),
+                                                                this->grad(this->p[BB], fx - 1, fy - 1, fz))
+                                    ),
+                                    this->lerp(row.fade,
+                                        this->lerp(column.fade, this->grad(this->p[AA + 1], fx, fy, fz - 1),
+                                                                this->grad(this->p[BA + 1], fx - 1, fy, fz - 1)),
+                                        this->lerp(column.fade, this->grad(this->p[AB + 1], fx, fy - 1, fz - 1),
+                                                                this->grad(this->p[BB + 1], fx - 1, fy - 1, fz - 1))
+                                    )
+                                );
+                                line[k] += value * amp;
+                            }
+                        }
+                    }
+
+                    scale *= this->octave_bias;
+                    amp /= this->octave_bias;
+                }
+
+                const T factor = ampl / this->weight(octv);
+                for (std::size_t i = 0; i < layer_size * size_z; i++) {
+                    out[i] *= factor;
+                }
+            }
+
+        private:
+
+            // Where a coordinate falls on the lattice: the wrapped cell, the
+            // offset in it and that offset faded
+            struct Lattice {
+                std::int32_t cell = 0;
+                T offset = 0;
+                T fade = 0;
+            };
+
+            [[nodiscard]]
+            static inline Lattice lattice(T t) noexcept {
+                const T floor = std::floor(t);
+                return {static_cast<std::int32_t>(floor) & 255, t - floor, fade(t - floor)};
+            }
+
+            static inline void lattice(vector<Lattice>& out, T origin, T step, T scale) noexcept {
+                for (std::size_t i = 0; i < out.size(); i++) {
+                    out[i] = lattice((origin + i * step) * scale);
+                }
+            }
+
+    };
+
+
+    using PerlinNoise = Basic_PerlinNoise<double>;
+
+
+    // Simplex noise on the same permutation as PerlinNoise: a seed gives the
+    // same serialize() bytes and the octave interfaces take the same
+    // arguments. It sums 3 corners in 2D, 4 in 3D and 5 in 4D against
+    // Perlin's 4 and 8, and has fewer axis aligned artifacts. noise4D with
+    // (z, w) on a circle gives animated noise that loops
+    template<typename T>
+    class Basic_SimplexNoise : public Basic_NoiseEngine<Basic_SimplexNoise<T>, T> {
+
+        // all of Simplex Noise core math was based on Stefan Gustavson's "Simplex noise demystified"
+
+        using Base = Basic_NoiseEngine<Basic_SimplexNoise<T>, T>;
+
+        private:
+
+            // skew to and unskew from the simplex grid, (sqrt(n + 1) - 1) / n and
+            // (1 - 1 / sqrt(n + 1)) / n
+            static constexpr T SKEW_2D = T(0.36602540378443864676);
+            static constexpr T UNSKEW_2D = T(0.21132486540518711775);
+            static constexpr T SKEW_3D = T(1.0 / 3.0);
+            static constexpr T UNSKEW_3D = T(1.0 / 6.0);
+            static constexpr T SKEW_4D = T(0.30901699437494742410);
+            static constexpr T UNSKEW_4D = T(0.13819660112501051518);
+
+            // midpoints of the cube edges, the 2D corners use their (x, y)
+            static constexpr std::array<std::array<T, 3>, 12> GRAD_3D {{
+                {1, 1, 0}, {-1, 1, 0}, {1, -1, 0}, {-1, -1, 0},
+                {1, 0, 1}, {-1, 0, 1}, {1, 0, -1}, {-1, 0, -1},
+                {0, 1, 1}, {0, -1, 1}, {0, 1, -1}, {0, -1, -1}
+            }};
+
+            // midpoints of the tesseract's cubes
+            static constexpr std::array<std::array<T, 4>, 32> GRAD_4D {{
+                {0, 1, 1, 1}, {0, 1, 1, -1}, {0, 1, -1, 1}, {0, 1, -1, -1},
+                {0, -1, 1, 1}, {0, -1, 1, -1}, {0, -1, -1, 1}, {0, -1, -1, -1},
+                {1, 0, 1, 1}, {1, 0, 1, -1}, {1, 0, -1, 1}, {1, 0, -1, -1},
+                {-1, 0, 1, 1}, {-1, 0, 1, -1}, {-1, 0, -1, 1}, {-1, 0, -1, -1},
+                {1, 1, 0, 1}, {1, 1, 0, -1}, {1, -1, 0, 1}, {1, -1, 0, -1},
+                {-1, 1, 0, 1}, {-1, 1, 0, -1}, {-1, -1, 0, 1}, {-1, -1, 0, -1},
+                {1, 1, 1, 0}, {1, 1, -1, 0}, {1, -1, 1, 0}, {1, -1, -1, 0},
+                {-1, 1, 1, 0}, {-1, 1, -1, 0}, {-1, -1, 1, 0}, {-1, -1, -1, 0}
+            }};
+
+        public:
+
+            Basic_SimplexNoise(uint32_t seed = 0) : Base(seed) {}
+
+        private:
+
+            // ############################################################################
+            // #                                                                          #
+            // #                               internals                                  #
+            // #                                                                          #
+            // ############################################################################
+
+            [[nodiscard]]
+            static inline std::int32_t cell(const T t) noexcept {
+                return static_cast<std::int32_t>(std::floor(t));
+            }
+
+            // a corner's falloff t^4 times its gradient's dot with the offset,
+            // zero once the squared distance passes 0.5 in 2D and 0.6 above
+            [[nodiscard]]
+            static inline T corner(const std::array<T, 3>& g, const T x, const T y) noexcept {
+                T t = T(0.5) - x * x - y * y;
+                if (t < 0) return 0;
+                t *= t;
+                return t * t * (g[0] * x + g[1] * y);
+            }
+
+            [[nodiscard]]
+            static inline T corner(const std::array<T, 3>& g, const T x, const T y, const T z) noexcept {
+                T t = T(0.6) - x * x - y * y - z * z;
+                if (t < 0) return 0;
+                t *= t;
+                return t * t * (g[0] * x + g[1] * y + g[2] * z);
+            }
+
+            [[nodiscard]]
+            static inline T corner(const std::array<T, 4>& g, const T x, const T y, const T z, const T w) noexcept {
+                T t = T(0.6) - x * x - y * y - z * z - w * w;
+                if (t < 0) return 0;
+                t *= t;
+                return t * t * (g[0] * x + g[1] * y + g[2] * z + g[3] * w);
+            }
+
+        public:
+
+            // In about [-1, 1] like PerlinNoise::raw_noise
+            [[nodiscard]]
+            T raw_noise(const T x, const T y) const noexcept {
+
+                const T s = (x + y) * SKEW_2D;
+                const std::int32_t i = cell(x + s);
+                const std::int32_t j = cell(y + s);
+                const T t = (i + j) * UNSKEW_2D;
+                const T x0 = x - (i - t);
+                const T y0 = y - (j - t);
+
+                // lower or upper triangle of the skewed cell
+                const std::int32_t i1 = x0 > y0 ? 1 : 0;
+                const std::int32_t j1 = 1 - i1;
+
+                const T x1 = x0 - i1 + UNSKEW_2D, y1 = y0 - j1 + UNSKEW_2D;
+                const T x2 = x0 - 1 + 2 * UNSKEW_2D, y2 = y0 - 1 + 2 * UNSKEW_2D;
+
+                const std::int32_t ii = i & 255, jj = j & 255;
+                return 70 * (
+                    corner(GRAD_3D[this->p[ii + this->p[jj]] % 12], x0, y0) +
+                    corner(GRAD_3D[this->p[ii + i1 + this->p[jj + j1]] % 12], x1, y1) +
+                    corner(GRAD_3D[this->p[ii + 1 + this->p[jj + 1]] % 12], x2, y2)
+                );
+            }
+
+            [[nodiscard]]
+            T raw_noise(const T x, const T y, const T z) const noexcept {
+
+                const T s = (x + y + z) * SKEW_3D;
+                const std::int32_t i = cell(x + s);
+                const std::int32_t j = cell(y + s);
+                const std::int32_t k = cell(z + s);
+                const T t = (i + j + k) * UNSKEW_3D;
+                const T x0 = x - (i - t);
+                const T y0 = y - (j - t);
+                const T z0 = z - (k - t);
+
+                // which of the six tetrahedra of the skewed cube, by the order
+                // of the offsets
+                std::int32_t i1, j1, k1, i2, j2, k2;
+                if (x0 >= y0) {
+                    if (y0 >= z0)      { i1 = 1; j1 = 0; k1 = 0; i2 = 1; j2 = 1; k2 = 0; }
+                    else if (x0 >= z0) { i1 = 1; j1 = 0; k1 = 0; i2 = 1; j2 = 0; k2 = 1; }
+                    else               { i1 = 0; j1 = 0; k1 = 1; i2 = 1; j2 = 0; k2 = 1; }
+                }
+                else {
+                    if (y0 < z0)       { i1 = 0; j1 = 0; k1 = 1; i2 = 0; j2 = 1; k2 = 1; }
+                    else if (x0 < z0)  { i1 = 0; j1 = 1; k1 = 0; i2 = 0; j2 = 1; k2 = 1; }
+                    else               { i1 = 0; j1 = 1; k1 = 0; i2 = 1; j2 = 1; k2 = 0; }
+                }
+
+                const T x1 = x0 - i1 + UNSKEW_3D, y1 = y0 - j1 + UNSKEW_3D, z1 = z0 - k1 + UNSKEW_3D;
+                const T x2 = x0 - i2 + 2 * UNSKEW_3D, y2 = y0 - j2 + 2 * UNSKEW_3D, z2 = z0 - k2 + 2 * UNSKEW_3D;
+                const T x3 = x0 - 1 + 3 * UNSKEW_3D, y3 = y0 - 1 + 3 * UNSKEW_3D, z3 = z0 - 1 + 3 * UNSKEW_3D;
+
+                const std::int32_t ii = i & 255, jj = j & 255, kk = k & 255;
+                const auto& p = this->p;
+                return 32 * (
+                    corner(GRAD_3D[p[ii + p[jj + p[kk]]] % 12], x0, y0, z0) +
+                    corner(GRAD_3D[p[ii + i1 + p[jj + j1 + p[kk + k1]]] % 12], x1, y1, z1) +
+                    corner(GRAD_3D[p[ii + i2 + p[jj + j2 + p[kk + k2]]] % 12], x2, y2, z2) +
+                    corner(GRAD_3D[p[ii + 1 + p[jj + 1 + p[kk + 1]]] % 12], x3, y3, z3)
                 );
             }
-        
-            
-            // ############################################################################
-            // #                                                                          #
-            // #                               interfaces                                 #
-            // #                                                                          #
-            // ############################################################################
 
             [[nodiscard]]
-            double noise1D(double x, const double octv, const double freq, double ampl) const noexcept {
-                
-                x = x / freq;
-                double result = 0;
-                double amp = 1;
-                for (std::int32_t i = 0; i < octv; ++i) {
-                    result += this->raw_noise(x, 0, 0) * amp;
-                    x *= octave_bias;
-                    amp /= octave_bias;
+            T raw_noise(const T x, const T y, const T z, const T w) const noexcept {
+
+                const T s = (x + y + z + w) * SKEW_4D;
+                const std::int32_t i = cell(x + s);
+                const std::int32_t j = cell(y + s);
+                const std::int32_t k = cell(z + s);
+                const std::int32_t l = cell(w + s);
+                const T t = (i + j + k + l) * UNSKEW_4D;
+                const std::array<T, 4> d0 {x - (i - t), y - (j - t), z - (k - t), w - (l - t)};
+
+                // rank the offsets, the simplex steps along the largest first
+                std::array<std::int32_t, 4> rank {0, 0, 0, 0};
+                for (std::size_t a = 0; a < 4; a++) {
+                    for (std::size_t b = a + 1; b < 4; b++) {
+                        if (d0[a] > d0[b]) rank[a]++;
+                        else rank[b]++;
+                    }
+                }
+
+                const std::array<std::int32_t, 4> cells {i & 255, j & 255, k & 255, l & 255};
+                const auto& p = this->p;
+
+                T result = 0;
+                for (std::int32_t corner_index = 0; corner_index <= 4; corner_index++) {
+
+                    // corner n steps on the axes ranked 4 - n or higher
+                    std::array<std::int32_t, 4> step;
+                    std::array<T, 4> d;
+                    for (std::size_t a = 0; a < 4; a++) {
+                        step[a] = rank[a] >= 4 - corner_index ? 1 : 0;
+                        d[a] = d0[a] - step[a] + corner_index * UNSKEW_4D;
+                    }
+
+                    const std::uint8_t hash = p[cells[0] + step[0] + p[cells[1] + step[1] + p[cells[2] + step[2] + p[cells[3] + step[3]]]]];
+                    result += corner(GRAD_4D[hash % 32], d[0], d[1], d[2], d[3]);
+                }
+                return 27 * result;
+            }
+
+            // ############################################################################
+            // #                                                                          #
+            // #                               interfaces                                 #
+            // #                                                                          #
+            // ############################################################################
+
+            [[nodiscard]]
+            T noise4D(T x, T y, T z, T w, const T octv, const T freq, T ampl) const noexcept {
+
+                x = x / freq;
+                y = y / freq;
+                z = z / freq;
+                w = w / freq;
+                T result = 0;
+                T amp = 1;
+                for (std::int32_t i = 0; i < octv; ++i) {
+                    result += this->raw_noise(x, y, z, w) * amp;
+                    x *= this->octave_bias;
+                    y *= this->octave_bias;
+                    z *= this->octave_bias;
+                    w *= this->octave_bias;
+                    amp /= this->octave_bias;
+                }
+
+                return (result / this->weight(octv)) * ampl;
+            }
+    };
+
+    using SimplexNoise = Basic_SimplexNoise<double>;
+
+
+    // Generates size by size chunks of noise2D on a ThreadPool as a streaming
+    // world moves and keeps the finished ones in an LRU cache capped by
+    // memory. Requested chunks are generated nearest to the viewer first.
+    // Sample (i, j) of chunk (cx, cy) is the noise at
+    // ((cx * size + i) * step, (cy * size + j) * step), so a chunk comes out
+    // the same whatever the thread count or the order it was made in
+    template<typename T>
+    class Basic_NoiseChunks {
+
+        public:
+
+            using Chunk = std::shared_ptr<const vector<T>>;
+
+            struct Settings {
+                // samples per chunk side
+                std::size_t size = 64;
+                // world distance between samples
+                T step = 1;
+                T octaves = 4;
+                T frequency = 64;
+                T amplitude = 1;
+                // bytes of samples the cache keeps, at least one chunk is kept
+                std::size_t memory = std::size_t(64) << 20;
+            };
+
+        private:
+
+            struct KeyHash {
+                inline std::size_t operator()(const Vector2i& key) const noexcept {
+                    return static_cast<std::size_t>((uint64_t(uint32_t(key.x)) << 32 | uint32_t(key.y)) * 0x9E3779B97F4A7C15ull);
+                }
+            };
+
+            struct Entry {
+                Vector2i key;
+                Chunk samples;
+            };
+
+            using EntryList = std::list<Entry>;
+
+            const Basic_PerlinNoise<T>& noise;
+            ThreadPool& pool;
+            const Settings settings;
+
+            EntryList entries;
+            std::unordered_map<Vector2i, typename EntryList::iterator, KeyHash> index;
+
+            // requested chunks as a heap on distance to viewer, queued holds
+            // them and the ones being generated
+            vector<Vector2i> requests;
+            std::unordered_map<Vector2i, bool, KeyHash> queued;
+            Vector2i viewer {0, 0};
+            // jobs submitted and not yet finished
+            std::size_t jobs = 0;
+
+            mutable std::mutex mutex;
+            std::condition_variable done;
+
+        public:
+
+            // noise and pool must outlive the chunks
+            Basic_NoiseChunks(const Basic_PerlinNoise<T>& noise, ThreadPool& pool, Settings settings = {})
+            : noise(noise), pool(pool), settings(settings) {}
+
+            ~Basic_NoiseChunks() {
+                std::unique_lock<std::mutex> lock(this->mutex);
+                this->requests.clear();
+                this->done.wait(lock, [this]() { return this->jobs == 0; });
+            }
+
+            Basic_NoiseChunks(const Basic_NoiseChunks&) = delete;
+            Basic_NoiseChunks& operator=(const Basic_NoiseChunks&) = delete;
+
+            // The chunk the viewer is in, requests closer to it go first
+            void set_viewer(Vector2i chunk) {
+                const std::lock_guard<std::mutex> lock(this->mutex);
+                this->viewer = chunk;
+                std::make_heap(this->requests.begin(), this->requests.end(), this->farther());
+            }
+
+            // Queues chunk for generation unless it is cached or already queued
+            void request(Vector2i chunk) {
+                {
+                    const std::lock_guard<std::mutex> lock(this->mutex);
+                    if (this->index.count(chunk) || this->queued.count(chunk)) {
+                        return;
+                    }
+                    this->queued[chunk] = false;
+                    this->requests.push_back(chunk);
+                    std::push_heap(this->requests.begin(), this->requests.end(), this->farther());
+                    this->jobs++;
+                }
+                // each job generates whichever request is nearest when it runs
+                this->pool.submit([this]() { this->generate_next(); });
+            }
+
+            // Drops chunk from the queue if its generation has not started
+            void cancel(Vector2i chunk) {
+                const std::lock_guard<std::mutex> lock(this->mutex);
+                const auto found = this->queued.find(chunk);
+                if (found == this->queued.end() || found->second) {
+                    return;
+                }
+                this->queued.erase(found);
+                this->requests.erase(std::find(this->requests.begin(), this->requests.end(), chunk));
+                std::make_heap(this->requests.begin(), this->requests.end(), this->farther());
+            }
+
+            // The cached chunk or nullptr, does not block
+            [[nodiscard]]
+            Chunk get(Vector2i chunk) {
+                const std::lock_guard<std::mutex> lock(this->mutex);
+                return this->lookup(chunk);
+            }
+
+            // Requests chunk and blocks until it is generated
+            [[nodiscard]]
+            Chunk wait(Vector2i chunk) {
+
+                this->request(chunk);
+
+                std::unique_lock<std::mutex> lock(this->mutex);
+                Chunk result;
+                this->done.wait(lock, [&]() {
+                    result = this->lookup(chunk);
+                    return result || !this->queued.count(chunk);
+                });
+                if (result) {
+                    return result;
+                }
+
+                // evicted or cancelled in between, make it here
+                lock.unlock();
+                return this->make(chunk);
+            }
+
+            // Chunks cached
+            [[nodiscard]]
+            std::size_t size() const {
+                const std::lock_guard<std::mutex> lock(this->mutex);
+                return this->entries.size();
+            }
+
+            // Chunks requested and not finished yet
+            [[nodiscard]]
+            std::size_t queued_size() const {
+                const std::lock_guard<std::mutex> lock(this->mutex);
+                return this->queued.size();
+            }
+
+            // Bytes of samples cached
+            [[nodiscard]]
+            std::size_t memory() const {
+                const std::lock_guard<std::mutex> lock(this->mutex);
+                return this->entries.size() * this->chunk_bytes();
+            }
+
+            void clear() {
+                const std::lock_guard<std::mutex> lock(this->mutex);
+                this->entries.clear();
+                this->index.clear();
+            }
+
+        private:
+
+            // heap order, nearest to the viewer on top and ties broken by
+            // coordinates so the order does not depend on request timing
+            auto farther() const noexcept {
+                return [viewer = this->viewer](const Vector2i& a, const Vector2i& b) {
+                    const int64_t da = distance(a, viewer), db = distance(b, viewer);
+                    if (da != db) return da > db;
+                    return a.y != b.y ? a.y > b.y : a.x > b.x;
+                };
+            }
+
+            [[nodiscard]]
+            static inline int64_t distance(const Vector2i& a, const Vector2i& b) noexcept {
+                const int64_t x = int64_t(a.x) - b.x, y = int64_t(a.y) - b.y;
+                return x * x + y * y;
+            }
+
+            [[nodiscard]]
+            inline std::size_t chunk_bytes() const noexcept {
+                return this->settings.size * this->settings.size * sizeof(T);
+            }
+
+            Chunk lookup(const Vector2i& chunk) {
+                const auto found = this->index.find(chunk);
+                if (found == this->index.end()) {
+                    return nullptr;
                 }
+                this->entries.splice(this->entries.begin(), this->entries, found->second);
+                return found->second->samples;
+            }
 
-                return (result / this->weight(octv)) * ampl;
+            Chunk make(const Vector2i& chunk) const {
+                const std::size_t size = this->settings.size;
+                const T step = this->settings.step;
+                const int64_t side = static_cast<int64_t>(size);
+                auto samples = std::make_shared<vector<T>>(size * size);
+                this->noise.fill2D(samples->data(), static_cast<T>(chunk.x * side) * step,
+                                   static_cast<T>(chunk.y * side) * step, size, size, step,
+                                   this->settings.octaves, this->settings.frequency, this->settings.amplitude);
+                return samples;
             }
-            
+
+            void generate_next() {
+
+                std::unique_lock<std::mutex> lock(this->mutex);
+                if (!this->requests.empty()) {
+
+                    std::pop_heap(this->requests.begin(), this->requests.end(), this->farther());
+                    const Vector2i chunk = this->requests.back();
+                    this->requests.pop_back();
+                    this->queued[chunk] = true;
+
+                    lock.unlock();
+                    Chunk samples = this->make(chunk);
+                    lock.lock();
+
+                    this->queued.erase(chunk);
+                    this->store(chunk, std::move(samples));
+                }
+
+                this->jobs--;
+                // under the lock, the destructor may return as soon as it sees jobs == 0
+                this->done.notify_all();
+            }
+
+            void store(const Vector2i& chunk, Chunk samples) {
+
+                this->entries.push_front({chunk, std::move(samples)});
+                this->index.emplace(chunk, this->entries.begin());
+
+                const std::size_t capacity = std::max<std::size_t>(1, this->settings.memory / std::max<std::size_t>(1, this->chunk_bytes()));
+                while (this->entries.size() > capacity) {
+                    this->index.erase(this->entries.back().key);
+                    this->entries.pop_back();
+                }
+            }
+    };
+
+    using NoiseChunks = Basic_NoiseChunks<double>;
+
+
+    // Header of a noise chunk file. The payload after it holds
+    // chunks_x * chunks_y chunks row by row, each chunk_size * chunk_size
+    // samples row by row padded to 64 bytes. Files are in the writer's byte
+    // order, endian_mark tells readers on the other one apart
+    struct NoiseChunkHeader {
+        std::array<char, 8> magic;
+        uint32_t version;
+        uint32_t endian_mark;
+        // NoiseChunkFile::Format
+        uint32_t format;
+        uint32_t chunk_size;
+        uint32_t chunks_x;
+        uint32_t chunks_y;
+        // chunk coordinates of the first chunk
+        int32_t origin_x;
+        int32_t origin_y;
+        double step;
+        double octaves;
+        double frequency;
+        double amplitude;
+        // range UNORM16 samples are quantized over
+        double min;
+        double max;
+        // the engine's serialize() output
+        std::array<uint8_t, 256> permutation;
+        std::array<uint8_t, 168> reserved;
+    };
+
+    static_assert(sizeof(NoiseChunkHeader) == 512, "NoiseChunkHeader layout is part of the file format");
+
+    // Seeded terrain saved once and mapped back on later runs instead of
+    // regenerated. write() generates the chunks of a PerlinNoise in
+    // parallel, as Basic_NoiseChunks lays them out, and open() maps the file
+    // read only (mmap where available, read in whole otherwise) so samples()
+    // points straight into it
+    class NoiseChunkFile {
+
+        public:
+
+            static constexpr std::array<char, 8> MAGIC {'B', 'O', 'A', 'R', 'N', 'C', 'F', 0};
+            static constexpr uint32_t VERSION = 1;
+            static constexpr uint32_t ENDIAN_MARK = 0x01020304;
+            // limits write() and valid() hold headers to, so a chunk's bytes
+            // and the chunk counts fit any size_t and int32_t math below
+            static constexpr uint32_t MAX_CHUNK_SIZE = 4096;
+            static constexpr uint32_t MAX_CHUNKS = 65536;
+
+            enum class Format : uint32_t {
+                FLOAT32 = 0,
+                FLOAT64 = 1,
+                // [min, max] quantized to 0 to 65535, clamped
+                UNORM16 = 2
+            };
+
+            struct Params {
+                uint32_t chunk_size = 64;
+                double step = 1;
+                double octaves = 4;
+                double frequency = 64;
+                double amplitude = 1;
+                Format format = Format::FLOAT32;
+                double min = -1;
+                double max = 1;
+            };
+
+        private:
+
+            const unsigned char* bytes = nullptr;
+            std::size_t length = 0;
+#if defined(BOAR_HAS_MMAP)
+            bool mapped = false;
+#endif
+            vector<unsigned char> buffer;
+
+        public:
+
+            NoiseChunkFile() = default;
+
+            ~NoiseChunkFile() {
+                this->close();
+            }
+
+            NoiseChunkFile(const NoiseChunkFile&) = delete;
+            NoiseChunkFile& operator=(const NoiseChunkFile&) = delete;
+
+            // Generates chunks (origin.x, origin.y) to (origin.x + count.x - 1,
+            // origin.y + count.y - 1) of noise into path. Returns false when
+            // the file could not be written, for UNORM16 without a range
+            // (max not above min), or past MAX_CHUNK_SIZE and MAX_CHUNKS
+            template<typename T>
+            static bool write(const std::string& path, const Basic_PerlinNoise<T>& noise, Vector2i origin, Vector2ui count,
+                              const Params& params, ThreadPool& pool) {
+
+                if (params.format == Format::UNORM16 && !(params.max > params.min)) {
+                    return false;
+                }
+                if (params.chunk_size > MAX_CHUNK_SIZE || count.x > MAX_CHUNKS || count.y > MAX_CHUNKS) {
+                    return false;
+                }
+
+                NoiseChunkHeader header {};
+                header.magic = MAGIC;
+                header.version = VERSION;
+                header.endian_mark = ENDIAN_MARK;
+                header.format = static_cast<uint32_t>(params.format);
+                header.chunk_size = std::max<uint32_t>(1, params.chunk_size);
+                header.chunks_x = count.x;
+                header.chunks_y = count.y;
+                header.origin_x = origin.x;
+                header.origin_y = origin.y;
+                header.step = params.step;
+                header.octaves = params.octaves;
+                header.frequency = params.frequency;
+                header.amplitude = params.amplitude;
+                header.min = params.min;
+                header.max = params.max;
+                noise.serialize(header.permutation);
+
+                const std::size_t chunks = static_cast<std::size_t>(count.x) * count.y;
+                const std::size_t stride = chunk_stride(header);
+                if (chunks > (std::numeric_limits<std::size_t>::max() - sizeof(NoiseChunkHeader)) / stride) {
+                    return false;
+                }
+                const std::size_t total = sizeof(NoiseChunkHeader) + chunks * stride;
+
+                unsigned char* file = nullptr;
+                vector<unsigned char> memory;
+
+#if defined(BOAR_HAS_MMAP)
+                const int descriptor = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+                if (descriptor < 0) {
+                    return false;
+                }
+                if (::ftruncate(descriptor, static_cast<off_t>(total)) != 0) {
+                    ::close(descriptor);
+                    return false;
+                }
+                void* map = ::mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+                ::close(descriptor);
+                if (map == MAP_FAILED) {
+                    return false;
+                }
+                file = static_cast<unsigned char*>(map);
+#else
+                memory.resize(total);
+                file = memory.data();
+#endif
+
+                std::memcpy(file, &header, sizeof(header));
+
+                const std::size_t size = header.chunk_size;
+                vector<vector<T>> scratch(pool.size(), vector<T>(size * size));
+                pool.parallel_for(chunks, [&](std::size_t i, std::size_t worker) {
+
+                    const int64_t side = static_cast<int64_t>(size);
+                    const int64_t x = origin.x + static_cast<int64_t>(i % count.x);
+                    const int64_t y = origin.y + static_cast<int64_t>(i / count.x);
+                    const T step = static_cast<T>(params.step);
+
+                    T* samples = scratch[worker].data();
+                    noise.fill2D(samples, static_cast<T>(x * side) * step, static_cast<T>(y * side) * step, size, size, step,
+                                 static_cast<T>(params.octaves), static_cast<T>(params.frequency), static_cast<T>(params.amplitude));
+                    encode(header, samples, file + sizeof(NoiseChunkHeader) + i * stride);
+                });
+
+#if defined(BOAR_HAS_MMAP)
+                const bool synced = ::msync(file, total, MS_SYNC) == 0;
+                ::munmap(file, total);
+                return synced;
+#else
+                std::FILE* out = std::fopen(path.c_str(), "wb");
+                if (!out) {
+                    return false;
+                }
+                const bool written = std::fwrite(memory.data(), 1, total, out) == total;
+                return std::fclose(out) == 0 && written;
+#endif
+            }
+
+            // Maps path, returns false if it is missing or not a chunk file
+            // this build can read
+            bool open(const std::string& path) {
+
+                this->close();
+
+#if defined(BOAR_HAS_MMAP)
+                const int descriptor = ::open(path.c_str(), O_RDONLY);
+                if (descriptor < 0) {
+                    return false;
+                }
+                struct stat status;
+                if (::fstat(descriptor, &status) != 0 || status.st_size < static_cast<off_t>(sizeof(NoiseChunkHeader))) {
+                    ::close(descriptor);
+                    return false;
+                }
+                void* map = ::mmap(nullptr, static_cast<std::size_t>(status.st_size), PROT_READ, MAP_SHARED, descriptor, 0);
+                ::close(descriptor);
+                if (map == MAP_FAILED) {
+                    return false;
+                }
+                this->bytes = static_cast<const unsigned char*>(map);
+                this->length = static_cast<std::size_t>(status.st_size);
+                this->mapped = true;
+#else
+                std::FILE* in = std::fopen(path.c_str(), "rb");
+                if (!in) {
+                    return false;
+                }
+                unsigned char block[4096];
+                for (std::size_t read; (read = std::fread(block, 1, sizeof(block), in)) > 0;) {
+                    this->buffer.insert(this->buffer.end(), block, block + read);
+                }
+                std::fclose(in);
+                this->bytes = this->buffer.data();
+                this->length = this->buffer.size();
+#endif
+
+                if (!this->valid()) {
+                    this->close();
+                    return false;
+                }
+                return true;
+            }
+
+            void close() noexcept {
+#if defined(BOAR_HAS_MMAP)
+                if (this->mapped) {
+                    ::munmap(const_cast<unsigned char*>(this->bytes), this->length);
+                    this->mapped = false;
+                }
+#endif
+                this->buffer.clear();
+                this->bytes = nullptr;
+                this->length = 0;
+            }
+
             [[nodiscard]]
-            double noise2D(double x, double y, const double octv, const double freq, double ampl) const noexcept {
-                
-                x = x / freq;
-                y = y / freq;
-                double result = 0;
-                double amp = 1;
-                for (std::int32_t i = 0; i < octv; ++i) {
-                    result += this->raw_noise(x, y, 0) * amp;
-                    x *= octave_bias;
-                    y *= octave_bias;
-                    amp /= octave_bias;
+            inline bool is_open() const noexcept {
+                return this->bytes != nullptr;
+            }
+
+            // Only valid while open
+            [[nodiscard]]
+            inline const NoiseChunkHeader& header() const noexcept {
+                return *reinterpret_cast<const NoiseChunkHeader*>(this->bytes);
+            }
+
+            [[nodiscard]]
+            inline Format format() const noexcept {
+                return static_cast<Format>(this->header().format);
+            }
+
+            // Reseeds engine to the noise the file was generated from
+            template<typename Engine>
+            void restore(Engine& engine) const noexcept {
+                engine.deserialize(this->header().permutation);
+            }
+
+            [[nodiscard]]
+            inline bool contains(Vector2i chunk) const noexcept {
+                const NoiseChunkHeader& header = this->header();
+                const int64_t x = int64_t(chunk.x) - header.origin_x;
+                const int64_t y = int64_t(chunk.y) - header.origin_y;
+                return x >= 0 && y >= 0 && x < header.chunks_x && y < header.chunks_y;
+            }
+
+            // The chunk's samples in the file, nullptr if the file does not
+            // have it or stores another sample type than Sample (float for
+            // FLOAT32, double for FLOAT64, uint16_t for UNORM16)
+            template<typename Sample>
+            [[nodiscard]]
+            const Sample* samples(Vector2i chunk) const noexcept {
+                if (!this->contains(chunk) || !matches<Sample>(this->format())) {
+                    return nullptr;
+                }
+                return reinterpret_cast<const Sample*>(this->payload(chunk));
+            }
+
+            // Decodes the chunk's chunk_size * chunk_size samples into out,
+            // false if the file does not have it
+            template<typename T>
+            bool read(Vector2i chunk, T* out) const noexcept {
+
+                if (!this->contains(chunk)) {
+                    return false;
                 }
 
-                return (result / this->weight(octv)) * ampl;
+                const NoiseChunkHeader& header = this->header();
+                const std::size_t count = static_cast<std::size_t>(header.chunk_size) * header.chunk_size;
+                const unsigned char* from = this->payload(chunk);
+
+                switch (this->format()) {
+                    case Format::FLOAT32:
+                        std::copy_n(reinterpret_cast<const float*>(from), count, out);
+                        break;
+                    case Format::FLOAT64:
+                        std::copy_n(reinterpret_cast<const double*>(from), count, out);
+                        break;
+                    case Format::UNORM16: {
+                        const uint16_t* quantized = reinterpret_cast<const uint16_t*>(from);
+                        const double scale = (header.max - header.min) / 65535;
+                        for (std::size_t i = 0; i < count; i++) {
+                            out[i] = static_cast<T>(header.min + quantized[i] * scale);
+                        }
+                        break;
+                    }
+                }
+                return true;
             }
-            
+
+        private:
+
+            template<typename Sample>
+            static constexpr bool matches(Format format) noexcept {
+                switch (format) {
+                    case Format::FLOAT32: return std::is_same_v<Sample, float>;
+                    case Format::FLOAT64: return std::is_same_v<Sample, double>;
+                    case Format::UNORM16: return std::is_same_v<Sample, uint16_t>;
+                }
+                return false;
+            }
+
             [[nodiscard]]
-            double noise3D(double x, double y, double z, const double octv, const double freq, double ampl) const noexcept {
-                
-                x = x / freq;
-                y = y / freq;
-                z = z / freq;
-                double result = 0;
-                double amp = 1;
-                for (std::int32_t i = 0; i < octv; ++i) {
-                    result += this->raw_noise(x, y, z) * amp;
-                    x *= octave_bias;
-                    y *= octave_bias;
-                    z *= octave_bias;
-                    amp /= octave_bias;
+            static inline std::size_t sample_bytes(uint32_t format) noexcept {
+                switch (static_cast<Format>(format)) {
+                    case Format::FLOAT32: return sizeof(float);
+                    case Format::FLOAT64: return sizeof(double);
+                    case Format::UNORM16: return sizeof(uint16_t);
                 }
+                return 0;
+            }
 
-                return (result / this->weight(octv)) * ampl;
+            [[nodiscard]]
+            static inline std::size_t chunk_stride(const NoiseChunkHeader& header) noexcept {
+                const std::size_t bytes = static_cast<std::size_t>(header.chunk_size) * header.chunk_size * sample_bytes(header.format);
+                return (bytes + 63) / 64 * 64;
             }
 
+            [[nodiscard]]
+            inline const unsigned char* payload(Vector2i chunk) const noexcept {
+                const NoiseChunkHeader& header = this->header();
+                const std::size_t index = static_cast<std::size_t>(int64_t(chunk.y) - header.origin_y) * header.chunks_x +
+                                          static_cast<std::size_t>(int64_t(chunk.x) - header.origin_x);
+                return this->bytes + sizeof(NoiseChunkHeader) + index * chunk_stride(header);
+            }
 
-            // ############################################################################ 
-            // #                                                                          #
-            // #                                   I/O                                    #
-            // #                                                                          #
-            // ############################################################################
+            template<typename T>
+            static void encode(const NoiseChunkHeader& header, const T* samples, unsigned char* to) noexcept {
 
+                const std::size_t count = static_cast<std::size_t>(header.chunk_size) * header.chunk_size;
+                switch (static_cast<Format>(header.format)) {
+                    case Format::FLOAT32:
+                        std::copy_n(samples, count, reinterpret_cast<float*>(to));
+                        break;
+                    case Format::FLOAT64:
+                        std::copy_n(samples, count, reinterpret_cast<double*>(to));
+                        break;
+                    case Format::UNORM16: {
+                        uint16_t* quantized = reinterpret_cast<uint16_t*>(to);
+                        const double scale = 65535 / (header.max - header.min);
+                        for (std::size_t i = 0; i < count; i++) {
+                            const double unit = std::clamp((samples[i] - header.min) * scale, 0.0, 65535.0);
+                            quantized[i] = static_cast<uint16_t>(unit + 0.5);
+                        }
+                        break;
+                    }
+                }
+            }
 
-            void serialize(std::array<std::uint8_t, 256>& s) const noexcept {
-                for (std::size_t i = 0; i < 256; ++i)
-                {
-                    s[i] = this->p[i];
+            // the header checks, then the size the header implies. The chunk
+            // count is compared against the payload divided by the stride, a
+            // hostile header cannot overflow the product
+            [[nodiscard]]
+            bool valid() const noexcept {
+
+                if (this->length < sizeof(NoiseChunkHeader)) {
+                    return false;
+                }
+                const NoiseChunkHeader& header = this->header();
+                if (header.magic != MAGIC || header.version != VERSION || header.endian_mark != ENDIAN_MARK ||
+                    sample_bytes(header.format) == 0 || header.chunk_size == 0 || header.chunk_size > MAX_CHUNK_SIZE ||
+                    header.chunks_x > MAX_CHUNKS || header.chunks_y > MAX_CHUNKS) {
+                    return false;
                 }
+                if (static_cast<Format>(header.format) == Format::UNORM16 && !(header.max > header.min)) {
+                    return false;
+                }
+                const uint64_t chunks = uint64_t(header.chunks_x) * header.chunks_y;
+                return chunks <= (this->length - sizeof(NoiseChunkHeader)) / chunk_stride(header);
             }
+    };
 
-            void deserialize(const std::array<std::uint8_t, 256>& s) noexcept {
-                for (std::size_t i = 0; i < 256; ++i)
-                {
-                    this->p[256 + i] = this->p[i] = s[i];
+
+    // Noise graphs: fbm(), ridged() and billow() over a noise engine, chained
+    // with warp(), clamp(), remap(), + and *. The graph is a type, so
+    // evaluating it is a single inlined pass per sample without intermediate
+    // buffers, and fill() writes a region of it.
+    //
+    //     const auto height = noise_graph::remap(
+    //         noise_graph::warp(noise_graph::ridged(perlin, 5, 200), noise_graph::fbm(perlin, 2, 80),
+    //                           noise_graph::fbm(simplex, 2, 80), 30) * 0.7 + noise_graph::billow(perlin, 3, 50) * 0.3,
+    //         -1, 1, 0, 255);
+    //     noise_graph::fill(height, out, 0, 0, 512, 512, 1);
+    namespace noise_graph {
+
+        // Base of every node, Derived has a value_type and
+        // value_type operator()(value_type x, value_type y) const
+        template<typename Derived>
+        struct Node {
+            [[nodiscard]]
+            inline const Derived& self() const noexcept {
+                return static_cast<const Derived&>(*this);
+            }
+        };
+
+        template<typename T>
+        struct Constant : Node<Constant<T>> {
+            using value_type = T;
+            T value;
+
+            Constant(T value) : value(value) {}
+
+            inline T operator()(T, T) const noexcept {
+                return this->value;
+            }
+        };
+
+        // engine.noise2D(x, y, octaves, frequency, amplitude)
+        template<typename Engine>
+        struct Fbm : Node<Fbm<Engine>> {
+            using value_type = typename Engine::value_type;
+            using T = value_type;
+
+            const Engine* engine;
+            T octaves, frequency, amplitude;
+
+            Fbm(const Engine& engine, T octaves, T frequency, T amplitude)
+            : engine(&engine), octaves(octaves), frequency(frequency), amplitude(amplitude) {}
+
+            inline T operator()(T x, T y) const noexcept {
+                return this->engine->noise2D(x, y, this->octaves, this->frequency, this->amplitude);
+            }
+        };
+
+        // Octaves of (1 - |noise|)^2, sharp crests where the noise crosses
+        // zero. In [0, amplitude]
+        template<typename Engine>
+        struct Ridged : Node<Ridged<Engine>> {
+            using value_type = typename Engine::value_type;
+            using T = value_type;
+
+            const Engine* engine;
+            T octaves, frequency, amplitude;
+
+            Ridged(const Engine& engine, T octaves, T frequency, T amplitude)
+            : engine(&engine), octaves(octaves), frequency(frequency), amplitude(amplitude) {}
+
+            inline T operator()(T x, T y) const noexcept {
+
+                x = x / this->frequency;
+                y = y / this->frequency;
+                T result = 0, weight = 0;
+                T amp = 1;
+                for (std::int32_t i = 0; i < this->octaves; ++i) {
+                    const T ridge = 1 - std::abs(this->engine->raw_noise(x, y));
+                    result += ridge * ridge * amp;
+                    weight += amp;
+                    x *= 2;
+                    y *= 2;
+                    amp /= 2;
                 }
+                return weight > 0 ? result / weight * this->amplitude : 0;
             }
+        };
 
-    };
+        // Octaves of 2 |noise| - 1, rounded lumps. In [-amplitude, amplitude]
+        template<typename Engine>
+        struct Billow : Node<Billow<Engine>> {
+            using value_type = typename Engine::value_type;
+            using T = value_type;
+
+            const Engine* engine;
+            T octaves, frequency, amplitude;
+
+            Billow(const Engine& engine, T octaves, T frequency, T amplitude)
+            : engine(&engine), octaves(octaves), frequency(frequency), amplitude(amplitude) {}
+
+            inline T operator()(T x, T y) const noexcept {
+
+                x = x / this->frequency;
+                y = y / this->frequency;
+                T result = 0, weight = 0;
+                T amp = 1;
+                for (std::int32_t i = 0; i < this->octaves; ++i) {
+                    result += (2 * std::abs(this->engine->raw_noise(x, y)) - 1) * amp;
+                    weight += amp;
+                    x *= 2;
+                    y *= 2;
+                    amp /= 2;
+                }
+                return weight > 0 ? result / weight * this->amplitude : 0;
+            }
+        };
+
+        // source at (x, y) moved by strength times (offset_x, offset_y) there
+        template<typename Source, typename OffsetX, typename OffsetY>
+        struct Warp : Node<Warp<Source, OffsetX, OffsetY>> {
+            using value_type = typename Source::value_type;
+            using T = value_type;
+
+            Source source;
+            OffsetX offset_x;
+            OffsetY offset_y;
+            T strength;
+
+            Warp(const Source& source, const OffsetX& offset_x, const OffsetY& offset_y, T strength)
+            : source(source), offset_x(offset_x), offset_y(offset_y), strength(strength) {}
+
+            inline T operator()(T x, T y) const noexcept {
+                return this->source(x + this->strength * this->offset_x(x, y), y + this->strength * this->offset_y(x, y));
+            }
+        };
+
+        template<typename A, typename B>
+        struct Add : Node<Add<A, B>> {
+            using value_type = typename A::value_type;
+            using T = value_type;
+
+            A a;
+            B b;
+
+            Add(const A& a, const B& b) : a(a), b(b) {}
+
+            inline T operator()(T x, T y) const noexcept {
+                return this->a(x, y) + this->b(x, y);
+            }
+        };
+
+        template<typename A, typename B>
+        struct Mul : Node<Mul<A, B>> {
+            using value_type = typename A::value_type;
+            using T = value_type;
+
+            A a;
+            B b;
+
+            Mul(const A& a, const B& b) : a(a), b(b) {}
+
+            inline T operator()(T x, T y) const noexcept {
+                return this->a(x, y) * this->b(x, y);
+            }
+        };
+
+        template<typename Source>
+        struct Clamp : Node<Clamp<Source>> {
+            using value_type = typename Source::value_type;
+            using T = value_type;
+
+            Source source;
+            T min, max;
+
+            Clamp(const Source& source, T min, T max) : source(source), min(min), max(max) {}
+
+            inline T operator()(T x, T y) const noexcept {
+                return std::clamp(this->source(x, y), this->min, this->max);
+            }
+        };
+
+        // Maps [from_min, from_max] linearly onto [to_min, to_max]
+        template<typename Source>
+        struct Remap : Node<Remap<Source>> {
+            using value_type = typename Source::value_type;
+            using T = value_type;
+
+            Source source;
+            T from_min, scale, to_min;
+
+            Remap(const Source& source, T from_min, T from_max, T to_min, T to_max)
+            : source(source), from_min(from_min), scale((to_max - to_min) / (from_max - from_min)), to_min(to_min) {}
+
+            inline T operator()(T x, T y) const noexcept {
+                return (this->source(x, y) - this->from_min) * this->scale + this->to_min;
+            }
+        };
+
+        // ############################################################################
+        // #                                                                          #
+        // #                               builders                                   #
+        // #                                                                          #
+        // ############################################################################
+
+        template<typename Engine>
+        [[nodiscard]]
+        inline Fbm<Engine> fbm(const Engine& engine, typename Engine::value_type octaves,
+                               typename Engine::value_type frequency, typename Engine::value_type amplitude = 1) {
+            return {engine, octaves, frequency, amplitude};
+        }
+
+        template<typename Engine>
+        [[nodiscard]]
+        inline Ridged<Engine> ridged(const Engine& engine, typename Engine::value_type octaves,
+                                     typename Engine::value_type frequency, typename Engine::value_type amplitude = 1) {
+            return {engine, octaves, frequency, amplitude};
+        }
+
+        template<typename Engine>
+        [[nodiscard]]
+        inline Billow<Engine> billow(const Engine& engine, typename Engine::value_type octaves,
+                                     typename Engine::value_type frequency, typename Engine::value_type amplitude = 1) {
+            return {engine, octaves, frequency, amplitude};
+        }
+
+        template<typename Source, typename OffsetX, typename OffsetY>
+        [[nodiscard]]
+        inline Warp<Source, OffsetX, OffsetY> warp(const Node<Source>& source, const Node<OffsetX>& offset_x,
+                                                   const Node<OffsetY>& offset_y, typename Source::value_type strength) {
+            return {source.self(), offset_x.self(), offset_y.self(), strength};
+        }
+
+        template<typename Source>
+        [[nodiscard]]
+        inline Clamp<Source> clamp(const Node<Source>& source, typename Source::value_type min, typename Source::value_type max) {
+            return {source.self(), min, max};
+        }
+
+        template<typename Source>
+        [[nodiscard]]
+        inline Remap<Source> remap(const Node<Source>& source, typename Source::value_type from_min, typename Source::value_type from_max,
+                                   typename Source::value_type to_min, typename Source::value_type to_max) {
+            return {source.self(), from_min, from_max, to_min, to_max};
+        }
+
+        template<typename A, typename B>
+        [[nodiscard]]
+        inline Add<A, B> operator+(const Node<A>& a, const Node<B>& b) {
+            return {a.self(), b.self()};
+        }
+
+        template<typename A>
+        [[nodiscard]]
+        inline Add<A, Constant<typename A::value_type>> operator+(const Node<A>& a, typename A::value_type b) {
+            return {a.self(), b};
+        }
+
+        template<typename B>
+        [[nodiscard]]
+        inline Add<Constant<typename B::value_type>, B> operator+(typename B::value_type a, const Node<B>& b) {
+            return {a, b.self()};
+        }
+
+        template<typename A, typename B>
+        [[nodiscard]]
+        inline Mul<A, B> operator*(const Node<A>& a, const Node<B>& b) {
+            return {a.self(), b.self()};
+        }
+
+        template<typename A>
+        [[nodiscard]]
+        inline Mul<A, Constant<typename A::value_type>> operator*(const Node<A>& a, typename A::value_type b) {
+            return {a.self(), b};
+        }
+
+        template<typename B>
+        [[nodiscard]]
+        inline Mul<Constant<typename B::value_type>, B> operator*(typename B::value_type a, const Node<B>& b) {
+            return {a, b.self()};
+        }
+
+        // ############################################################################
+        // #                                                                          #
+        // #                               region fill                                #
+        // #                                                                          #
+        // ############################################################################
+
+        // graph over size_x by size_y samples step apart from (x, y), written
+        // row by row to out
+        template<typename Graph>
+        void fill(const Node<Graph>& graph, typename Graph::value_type* out, typename Graph::value_type x, typename Graph::value_type y,
+                  std::size_t size_x, std::size_t size_y, typename Graph::value_type step) {
+
+            using T = typename Graph::value_type;
+            const Graph& evaluate = graph.self();
+            for (std::size_t j = 0; j < size_y; j++) {
+                T* line = out + j * size_x;
+                const T row = y + j * step;
+                for (std::size_t i = 0; i < size_x; i++) {
+                    line[i] = evaluate(x + i * step, row);
+                }
+            }
+        }
+
+        // Same, with the rows split over pool. The graph and its engines must
+        // be safe to call from several threads, which the noise engines are
+        template<typename Graph>
+        void fill(const Node<Graph>& graph, typename Graph::value_type* out, typename Graph::value_type x, typename Graph::value_type y,
+                  std::size_t size_x, std::size_t size_y, typename Graph::value_type step, ThreadPool& pool) {
+
+            using T = typename Graph::value_type;
+            const Graph& evaluate = graph.self();
+            pool.parallel_for(size_y, [&](std::size_t j, std::size_t) {
+                T* line = out + j * size_x;
+                const T row = y + j * step;
+                for (std::size_t i = 0; i < size_x; i++) {
+                    line[i] = evaluate(x + i * step, row);
+                }
+            });
+        }
+    }
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,203 @@
+// boarglib A_Star benchmark
+// Usage: astar_bench [file.map [file.scen]]
+// Runs the scenarios of a Moving AI .scen file, or random queries when none
+// is given, on a Moving AI .map file or on a generated map.
+// See LICENSE file for copyright and license details.
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "../algorithms.hpp"
+
+using namespace boar;
+
+struct Map {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    vector<char> passable;
+};
+
+struct Query {
+    Vector2ui start;
+    Vector2ui target;
+};
+
+// Moving AI maps, '.', 'G' and 'S' are passable
+static bool load_map(const char* path, Map& map) {
+
+    std::ifstream file(path);
+    std::string word;
+    while (file >> word && word != "map") {
+        if (word == "height") file >> map.height;
+        else if (word == "width") file >> map.width;
+        else if (word == "type") file >> word;
+    }
+    if (!file || map.width == 0 || map.height == 0) {
+        return false;
+    }
+
+    map.passable.assign(static_cast<std::size_t>(map.width) * map.height, 0);
+    std::string row;
+    for (uint32_t y = 0; y < map.height && file >> row; y++) {
+        for (uint32_t x = 0; x < map.width && x < row.size(); x++) {
+            map.passable[y * map.width + x] = row[x] == '.' || row[x] == 'G' || row[x] == 'S';
+        }
+    }
+    return true;
+}
+
+// Moving AI scenarios: bucket map width height sx sy gx gy optimal_length
+static bool load_scen(const char* path, const Map& map, vector<Query>& queries) {
+
+    std::ifstream file(path);
+    std::string line;
+    if (!std::getline(file, line)) {
+        return false;
+    }
+    while (std::getline(file, line)) {
+        std::istringstream fields(line);
+        std::string bucket, map_name;
+        uint32_t width, height, sx, sy, gx, gy;
+        if (!(fields >> bucket >> map_name >> width >> height >> sx >> sy >> gx >> gy)) {
+            continue;
+        }
+        if (sx < map.width && gx < map.width && sy < map.height && gy < map.height) {
+            queries.push_back({{sx, sy}, {gx, gy}});
+        }
+    }
+    return true;
+}
+
+// Random obstacles and walls with gaps
+static void generate_map(Map& map, uint32_t size, std::mt19937& rng) {
+
+    map.width = map.height = size;
+    map.passable.assign(static_cast<std::size_t>(size) * size, 1);
+    for (char& tile : map.passable) {
+        tile = rng() % 100 >= 15;
+    }
+    for (uint32_t wall = 32; wall < size; wall += 32) {
+        for (uint32_t i = 0; i < size; i++) {
+            if (i % 16 > 2) {
+                map.passable[wall * size + i] = 0;
+                map.passable[i * size + wall] = 0;
+            }
+        }
+    }
+}
+
+static void random_queries(const Map& map, std::size_t count, std::mt19937& rng, vector<Query>& queries) {
+
+    auto random_tile = [&]() {
+        while (true) {
+            Vector2ui tile(rng() % map.width, rng() % map.height);
+            if (map.passable[tile.y * map.width + tile.x]) {
+                return tile;
+            }
+        }
+    };
+    for (std::size_t i = 0; i < count; i++) {
+        queries.push_back({random_tile(), random_tile()});
+    }
+}
+
+template<typename Finder>
+static void run(const char* name, Finder& finder, const vector<Query>& queries) {
+
+    vector<double> latencies;
+    latencies.reserve(queries.size());
+
+    std::size_t solved = 0;
+    uint64_t expanded = 0, pushed = 0, decreased = 0, validator_calls = 0;
+    std::size_t peak_open = 0;
+    double total = 0;
+
+    for (const Query& query : queries) {
+        const auto begin = std::chrono::steady_clock::now();
+        const auto path = finder.find(query.start, query.target);
+        const double latency = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - begin).count();
+
+        latencies.push_back(latency);
+        total += latency;
+        solved += path.has_value();
+
+#ifdef BOAR_PATHFINDING_STATS
+        const auto& stats = finder.last_stats();
+        expanded += stats.expanded;
+        pushed += stats.pushed;
+        decreased += stats.decreased;
+        validator_calls += stats.validator_calls;
+        peak_open = std::max(peak_open, stats.peak_open);
+#endif
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p) {
+        return latencies.empty() ? 0.0 : latencies[static_cast<std::size_t>(p * (latencies.size() - 1))];
+    };
+
+    std::printf("%s\n", name);
+    std::printf("  queries %zu, solved %zu, total %.1f ms\n", queries.size(), solved, total / 1000);
+    std::printf("  latency us: p50 %.1f  p90 %.1f  p99 %.1f  max %.1f\n",
+                percentile(0.5), percentile(0.9), percentile(0.99), percentile(1.0));
+#ifdef BOAR_PATHFINDING_STATS
+    std::printf("  expanded %llu (%.2f M/s), pushed %llu, decreased %llu, validator calls %llu, peak open %zu\n",
+                (unsigned long long)expanded, total > 0 ? expanded / total : 0.0, (unsigned long long)pushed,
+                (unsigned long long)decreased, (unsigned long long)validator_calls, peak_open);
+#endif
+}
+
+int main(int argc, char** argv) {
+
+    std::mt19937 rng(1);
+    Map map;
+    vector<Query> queries;
+
+    if (argc > 1) {
+        if (!load_map(argv[1], map)) {
+            std::fprintf(stderr, "cannot read map %s\n", argv[1]);
+            return 1;
+        }
+    }
+    else {
+        generate_map(map, 512, rng);
+    }
+
+    if (argc > 2) {
+        if (!load_scen(argv[2], map, queries)) {
+            std::fprintf(stderr, "cannot read scenarios %s\n", argv[2]);
+            return 1;
+        }
+    }
+    else {
+        random_queries(map, 1000, rng, queries);
+    }
+
+    std::printf("map %ux%u, %zu queries\n", map.width, map.height, queries.size());
+
+    A_Star function_finder(true, map.width, map.height, [&map](Vector2i& pos) {
+        return map.passable[pos.y * map.width + pos.x] != 0;
+    });
+    run("A_Star", function_finder, queries);
+
+    PassabilityGrid grid(map.width, map.height);
+    for (uint32_t y = 0; y < map.height; y++) {
+        for (uint32_t x = 0; x < map.width; x++) {
+            grid.set(x, y, map.passable[y * map.width + x]);
+        }
+    }
+    Basic_A_Star grid_finder(true, map.width, map.height, std::cref(grid));
+    run("Basic_A_Star<PassabilityGrid>", grid_finder, queries);
+
+    grid_finder.set_bidirectional(true);
+    run("Basic_A_Star<PassabilityGrid> bidirectional", grid_finder, queries);
+
+    grid_finder.set_bidirectional(false);
+    grid_finder.set_jump_point_search(true);
+    run("Basic_A_Star<PassabilityGrid> with jump point search", grid_finder, queries);
+
+    return 0;
+}
@@ -0,0 +1,82 @@
+// boarglib noise benchmark
+// Usage: noise_bench [samples]
+// Compares samples per second of PerlinNoise and SimplexNoise through the
+// octave interfaces, in 2D and 3D, on random points.
+// See LICENSE file for copyright and license details.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include "../algorithms.hpp"
+
+using namespace boar;
+
+constexpr double OCTAVES = 4;
+constexpr double FREQUENCY = 64;
+
+struct Points {
+    vector<double> x;
+    vector<double> y;
+    vector<double> z;
+};
+
+// Runs sample(i) for every point and prints the rate, the sum keeps the
+// calls from being optimized out
+template<typename Sample>
+static double measure(const char* name, std::size_t count, const Sample& sample) {
+
+    double sum = 0;
+    const auto begin = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < count; i++) {
+        sum += sample(i);
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    std::printf("  %-24s %8.2f M samples/s  (checksum %.6f)\n", name, count / seconds / 1e6, sum);
+    return seconds;
+}
+
+int main(int argc, char** argv) {
+
+    const std::size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 2000000;
+
+    Points points;
+    std::mt19937 random(1);
+    std::uniform_real_distribution<double> coordinate(-10000, 10000);
+    for (std::size_t i = 0; i < count; i++) {
+        points.x.push_back(coordinate(random));
+        points.y.push_back(coordinate(random));
+        points.z.push_back(coordinate(random));
+    }
+
+    const PerlinNoise perlin(1);
+    const SimplexNoise simplex(1);
+
+    std::printf("%zu samples, %g octaves\n", count, OCTAVES);
+
+    std::printf("2D\n");
+    const double perlin_2d = measure("PerlinNoise", count, [&](std::size_t i) {
+        return perlin.noise2D(points.x[i], points.y[i], OCTAVES, FREQUENCY, 1);
+    });
+    const double simplex_2d = measure("SimplexNoise", count, [&](std::size_t i) {
+        return simplex.noise2D(points.x[i], points.y[i], OCTAVES, FREQUENCY, 1);
+    });
+    std::printf("  simplex / perlin speed  %.2fx\n", perlin_2d / simplex_2d);
+
+    std::printf("3D\n");
+    const double perlin_3d = measure("PerlinNoise", count, [&](std::size_t i) {
+        return perlin.noise3D(points.x[i], points.y[i], points.z[i], OCTAVES, FREQUENCY, 1);
+    });
+    const double simplex_3d = measure("SimplexNoise", count, [&](std::size_t i) {
+        return simplex.noise3D(points.x[i], points.y[i], points.z[i], OCTAVES, FREQUENCY, 1);
+    });
+    std::printf("  simplex / perlin speed  %.2fx\n", perlin_3d / simplex_3d);
+
+    std::printf("4D\n");
+    measure("SimplexNoise", count, [&](std::size_t i) {
+        return simplex.noise4D(points.x[i], points.y[i], points.z[i], points.x[count - 1 - i], OCTAVES, FREQUENCY, 1);
+    });
+
+    return 0;
+}
@@ -0,0 +1,105 @@
+// boarglib vector benchmark
+// Usage: vector_bench [pairs]
+// Compares operations per second of Vector2f and Vector2<Fixed> for
+// DistanceTo, WithinDistance, Normalized and AngleTo on random point pairs.
+// WithinDistance is also timed against DistanceTo(target) <= radius, the
+// comparison it replaces. The fixed point
+// checksums are sums of raw values, equal on every platform and compiler.
+// See LICENSE file for copyright and license details.
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+#include "../algorithms.hpp"
+
+using namespace boar;
+
+using Vector2x = Vector2<Fixed>;
+
+// Runs op(i) for every pair and prints the rate, the sum keeps the calls
+// from being optimized out
+template<typename Sum, typename Op>
+static double measure(const char* name, std::size_t count, const Op& op) {
+
+    Sum sum = 0;
+    const auto begin = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < count; i++) {
+        sum += op(i);
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    if constexpr (std::is_floating_point_v<Sum>) {
+        std::printf("  %-24s %8.2f M ops/s  (checksum %.6f)\n", name, count / seconds / 1e6, sum);
+    }
+    else {
+        std::printf("  %-24s %8.2f M ops/s  (checksum %lld)\n", name, count / seconds / 1e6, static_cast<long long>(sum));
+    }
+    return seconds;
+}
+
+int main(int argc, char** argv) {
+
+    const std::size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 4000000;
+
+    vector<Vector2f> from, to;
+    vector<Vector2x> fixed_from, fixed_to;
+    std::mt19937 random(1);
+    std::uniform_real_distribution<double> coordinate(-10000, 10000);
+    for (std::size_t i = 0; i < count; i++) {
+        const Vector2f a{coordinate(random), coordinate(random)};
+        const Vector2f b{coordinate(random), coordinate(random)};
+        fixed_from.push_back(a);
+        fixed_to.push_back(b);
+        // same points for both, as the fixed point rounding left them
+        from.push_back(fixed_from.back());
+        to.push_back(fixed_to.back());
+    }
+
+    std::printf("%zu pairs\n", count);
+
+    std::printf("DistanceTo\n");
+    const double double_distance = measure<double>("Vector2f", count, [&](std::size_t i) {
+        return from[i].DistanceTo(to[i]);
+    });
+    const double fixed_distance = measure<std::int64_t>("Vector2<Fixed>", count, [&](std::size_t i) {
+        return fixed_from[i].DistanceTo(fixed_to[i]).raw();
+    });
+    std::printf("  fixed / double speed    %.2fx\n", double_distance / fixed_distance);
+
+    const double radius = 10000;
+    const Fixed fixed_radius(radius);
+    std::printf("WithinDistance\n");
+    const double double_within = measure<std::int64_t>("Vector2f", count, [&](std::size_t i) {
+        return from[i].WithinDistance(to[i], radius);
+    });
+    const double fixed_within = measure<std::int64_t>("Vector2<Fixed>", count, [&](std::size_t i) {
+        return fixed_from[i].WithinDistance(fixed_to[i], fixed_radius);
+    });
+    const double fixed_compare = measure<std::int64_t>("Vector2<Fixed> DistanceTo", count, [&](std::size_t i) {
+        return fixed_from[i].DistanceTo(fixed_to[i]) <= fixed_radius;
+    });
+    std::printf("  fixed / double speed    %.2fx\n", double_within / fixed_within);
+    std::printf("  fixed / DistanceTo      %.2fx\n", fixed_compare / fixed_within);
+
+    std::printf("Normalized\n");
+    const double double_normalized = measure<double>("Vector2f", count, [&](std::size_t i) {
+        return from[i].Normalized().x;
+    });
+    const double fixed_normalized = measure<std::int64_t>("Vector2<Fixed>", count, [&](std::size_t i) {
+        return fixed_from[i].Normalized().x.raw();
+    });
+    std::printf("  fixed / double speed    %.2fx\n", double_normalized / fixed_normalized);
+
+    std::printf("AngleTo\n");
+    const double double_angle = measure<double>("Vector2f", count, [&](std::size_t i) {
+        return from[i].AngleTo(to[i]);
+    });
+    const double fixed_angle = measure<std::int64_t>("Vector2<Fixed>", count, [&](std::size_t i) {
+        return fixed_from[i].AngleTo(fixed_to[i]).raw();
+    });
+    std::printf("  fixed / double speed    %.2fx\n", double_angle / fixed_angle);
+
+    return 0;
+}
@@ -5,8 +5,14 @@ VERSION = 0.1
 PREFIX = /usr/local
 MANPREFIX = ${PREFIX}/share/man
 
+# SIMD kernels: SSE2 is on wherever the target has it (all of x86-64),
+# SIMDFLAGS = -mavx2 switches to AVX2 and -DBOAR_NO_SIMD to scalar code,
+# e.g. make noise_bench SIMDFLAGS=-mavx2
+SIMDFLAGS =
+
 # flags 
-CXXFLAGS = -g -std=c++17 -Wall -Wextra -pedantic -O0 
+CXXFLAGS = -g -std=c++17 -Wall -Wextra -pedantic -O0 -pthread ${SIMDFLAGS}
+BENCHFLAGS = -std=c++17 -Wall -Wextra -pedantic -O2 -DNDEBUG -pthread -DBOAR_PATHFINDING_STATS ${SIMDFLAGS}
 
 # compiler and linker
 CC = g++
@@ -6,15 +6,363 @@
 #include <functional>
 #include <cstdint>
 #include <type_traits>
+#include <vector>
+#include <queue>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <atomic>
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+#include <iterator>
+#include <array>
+#include <limits>
+
+// The batch kernels of Vector2Array and PerlinNoise use the widest of AVX2
+// and SSE2 the compiler targets, BOAR_NO_SIMD keeps them scalar. x86-64
+// compilers target SSE2 by default, AVX2 needs -mavx2 (SIMDFLAGS in
+// config.mk). There is no runtime dispatch, a binary built with -mavx2
+// needs an AVX2 CPU
+#if !defined(BOAR_NO_SIMD) && defined(__AVX2__)
+    #include <immintrin.h>
+    #define BOAR_SIMD_AVX2
+#elif !defined(BOAR_NO_SIMD) && defined(__SSE2__)
+    #include <emmintrin.h>
+    #define BOAR_SIMD_SSE2
+#endif
 
 using std::sqrt;
 using std::pow;
 using std::atan;
 
 namespace boar{
-    
+
+    // Signed fixed point number with Fraction fractional bits in an int32_t,
+    // Fixed is Q16.16. Results are exact integer results, bit identical on
+    // every machine, compiler and set of flags, as lockstep simulations need.
+    // Products and quotients go through int64_t, products round toward
+    // negative infinity and quotients toward zero. Overflow wraps modulo 2^32
+    // (done in uint32_t, never signed overflow); division by zero is undefined.
+    // sqrt and hypot are seeded by the double sqrt and corrected in integers,
+    // atan2 interpolates a table built by CORDIC up to Q11.20 and runs the
+    // CORDIC itself past that
+    template<std::int32_t Fraction>
+    class Basic_Fixed {
+
+        static_assert(Fraction > 0 && Fraction <= 29, "Fraction must leave a sign bit and room for pi");
+
+        private:
+
+            std::int32_t value = 0;
+
+            struct Raw {};
+            constexpr Basic_Fixed(std::int32_t raw, Raw) noexcept : value(raw) {}
+
+            // atan(2^-i) in Q2.30 radians
+            static constexpr std::array<std::int64_t, 31> ATAN_TABLE {
+                843314857, 497837829, 263043837, 133525159, 67021687, 33543516, 16775851, 8388437,
+                4194283, 2097149, 1048576, 524288, 262144, 131072, 65536, 32768,
+                16384, 8192, 4096, 2048, 1024, 512, 256, 128,
+                64, 32, 16, 8, 4, 2, 1
+            };
+            static constexpr std::int64_t PI_Q30 = 3373259426;
+            static constexpr std::int64_t HALF_PI_Q30 = 1686629713;
+
+            // atan2 interpolates ATAN_LOOKUP while the interpolation error,
+            // below 8e-8 radians, stays under a tenth of a step
+            static constexpr std::int32_t LOOKUP_MAX_FRACTION = 20;
+            static constexpr std::int32_t ATAN_STEPS_LOG = 10;
+            static constexpr std::int32_t ATAN_STEPS = std::int32_t(1) << ATAN_STEPS_LOG;
+
+        public:
+
+            static constexpr std::int32_t FRACTION = Fraction;
+            static constexpr std::int32_t ONE = std::int32_t(1) << Fraction;
+
+            constexpr Basic_Fixed() noexcept = default;
+
+            // Integers convert exactly, wrapping outside the integer range
+            constexpr Basic_Fixed(std::int32_t integer) noexcept
+            : value(static_cast<std::int32_t>(static_cast<std::uint32_t>(integer) << Fraction)) {}
+
+            // Rounds to the nearest step. Only use it on constants or input,
+            // double math is what this type keeps out of the simulation
+            constexpr explicit Basic_Fixed(double real) noexcept
+            : value(static_cast<std::int32_t>(real * ONE + (real < 0 ? -0.5 : 0.5))) {}
+
+            [[nodiscard]]
+            static constexpr Basic_Fixed from_raw(std::int32_t raw) noexcept {
+                return {raw, Raw{}};
+            }
+
+            [[nodiscard]]
+            constexpr std::int32_t raw() const noexcept {
+                return this->value;
+            }
+
+            constexpr explicit operator double() const noexcept { return static_cast<double>(this->value) / ONE; }
+            constexpr explicit operator float() const noexcept { return static_cast<float>(this->value) / ONE; }
+            // floor
+            constexpr explicit operator std::int32_t() const noexcept { return this->value >> Fraction; }
+            constexpr explicit operator std::int64_t() const noexcept { return this->value >> Fraction; }
+            constexpr explicit operator std::uint32_t() const noexcept { return static_cast<std::uint32_t>(this->value >> Fraction); }
+
+            ///////////////////////Operators/////////////////////////////////
+
+            [[nodiscard]]
+            constexpr Basic_Fixed operator-() const noexcept {
+                return from_raw(static_cast<std::int32_t>(0u - static_cast<std::uint32_t>(this->value)));
+            }
+
+            [[nodiscard]]
+            constexpr Basic_Fixed operator+(Basic_Fixed other) const noexcept {
+                return from_raw(static_cast<std::int32_t>(static_cast<std::uint32_t>(this->value) + static_cast<std::uint32_t>(other.value)));
+            }
+
+            [[nodiscard]]
+            constexpr Basic_Fixed operator-(Basic_Fixed other) const noexcept {
+                return from_raw(static_cast<std::int32_t>(static_cast<std::uint32_t>(this->value) - static_cast<std::uint32_t>(other.value)));
+            }
+
+            [[nodiscard]]
+            constexpr Basic_Fixed operator*(Basic_Fixed other) const noexcept {
+                return from_raw(static_cast<std::int32_t>((std::int64_t(this->value) * other.value) >> Fraction));
+            }
+
+            [[nodiscard]]
+            constexpr Basic_Fixed operator/(Basic_Fixed other) const noexcept {
+                return from_raw(static_cast<std::int32_t>((std::int64_t(this->value) * ONE) / other.value));
+            }
+
+            constexpr Basic_Fixed& operator+=(Basic_Fixed other) noexcept { return *this = *this + other; }
+            constexpr Basic_Fixed& operator-=(Basic_Fixed other) noexcept { return *this = *this - other; }
+            constexpr Basic_Fixed& operator*=(Basic_Fixed other) noexcept { return *this = *this * other; }
+            constexpr Basic_Fixed& operator/=(Basic_Fixed other) noexcept { return *this = *this / other; }
+
+            [[nodiscard]] constexpr bool operator==(Basic_Fixed other) const noexcept { return this->value == other.value; }
+            [[nodiscard]] constexpr bool operator!=(Basic_Fixed other) const noexcept { return this->value != other.value; }
+            [[nodiscard]] constexpr bool operator<(Basic_Fixed other) const noexcept { return this->value < other.value; }
+            [[nodiscard]] constexpr bool operator>(Basic_Fixed other) const noexcept { return this->value > other.value; }
+            [[nodiscard]] constexpr bool operator<=(Basic_Fixed other) const noexcept { return this->value <= other.value; }
+            [[nodiscard]] constexpr bool operator>=(Basic_Fixed other) const noexcept { return this->value >= other.value; }
+
+            ///////////////////////Mathematical Methods/////////////////////////////////
+
+            // floor(sqrt(value)) of a 64 bit integer. The hardware double
+            // sqrt only seeds it, within one of the answer, and the integer
+            // correction makes the result exact on any FPU
+            [[nodiscard]]
+            static std::uint64_t isqrt(std::uint64_t value) noexcept {
+
+                // the common case, with the signed conversions (the unsigned
+                // ones are slower on x86-64) and one branchless correction
+                // each way, the seed is never off by more
+                if (value <= std::uint64_t(INT64_MAX)) {
+                    std::uint64_t root = static_cast<std::uint64_t>(static_cast<std::int64_t>(std::sqrt(static_cast<double>(static_cast<std::int64_t>(value)))));
+                    root -= root * root > value;
+                    root += (root + 1) * (root + 1) <= value;
+                    return root;
+                }
+
+                constexpr std::uint64_t MAX_ROOT = 0xFFFFFFFF;
+                std::uint64_t root = std::min<std::uint64_t>(static_cast<std::uint64_t>(std::sqrt(static_cast<double>(value))), MAX_ROOT);
+                while (root * root > value) {
+                    root--;
+                }
+                while (root < MAX_ROOT && (root + 1) * (root + 1) <= value) {
+                    root++;
+                }
+                return root;
+            }
+
+            // 0 for negative values
+            [[nodiscard]]
+            static Basic_Fixed sqrt(Basic_Fixed value) noexcept {
+                if (value.value <= 0) {
+                    return Basic_Fixed{};
+                }
+                return from_raw(static_cast<std::int32_t>(isqrt(std::uint64_t(value.value) << Fraction)));
+            }
+
+            // sqrt(x^2 + y^2) without overflowing on the squares, saturates
+            [[nodiscard]]
+            static Basic_Fixed hypot(Basic_Fixed x, Basic_Fixed y) noexcept {
+                return hypot_raw(x.value, y.value);
+            }
+
+            // hypot of raw components wider than int32_t, such as the exact
+            // difference of two values. Only the result saturates
+            [[nodiscard]]
+            static Basic_Fixed hypot_raw(std::int64_t x, std::int64_t y) noexcept {
+                const std::uint64_t ax = x < 0 ? 0 - std::uint64_t(x) : std::uint64_t(x);
+                const std::uint64_t ay = y < 0 ? 0 - std::uint64_t(y) : std::uint64_t(y);
+                if (ax > INT32_MAX || ay > INT32_MAX) {
+                    return from_raw(INT32_MAX);
+                }
+                const std::uint64_t result = isqrt(ax * ax + ay * ay);
+                return from_raw(static_cast<std::int32_t>(std::min<std::uint64_t>(result, INT32_MAX)));
+            }
+
+            // Whether hypot_raw(x, y) <= radius without the square root, the
+            // squares compared exactly
+            [[nodiscard]]
+            static constexpr bool within_raw(std::int64_t x, std::int64_t y, Basic_Fixed radius) noexcept {
+                if (radius.value < 0) {
+                    return false;
+                }
+                const std::uint64_t ax = x < 0 ? 0 - std::uint64_t(x) : std::uint64_t(x);
+                const std::uint64_t ay = y < 0 ? 0 - std::uint64_t(y) : std::uint64_t(y);
+                const std::uint64_t r = static_cast<std::uint64_t>(radius.value);
+                // past the radius on one axis decides it, clamped to it the
+                // squares fit in 2^63. No branches, the outcome is often random
+                const std::uint64_t cx = std::min(ax, r), cy = std::min(ay, r);
+                return (ax <= r) & (ay <= r) & (cx * cx + cy * cy <= r * r);
+            }
+
+            [[nodiscard]]
+            static constexpr Basic_Fixed abs(Basic_Fixed value) noexcept {
+                return value.value < 0 ? -value : value;
+            }
+
+            // Angle of (x, y) in radians in [-pi, pi]
+            [[nodiscard]]
+            static constexpr Basic_Fixed atan2(Basic_Fixed y, Basic_Fixed x) noexcept {
+                return atan2_raw(y.value, x.value);
+            }
+
+            // atan2 of raw components wider than int32_t, below 2^40
+            [[nodiscard]]
+            static constexpr Basic_Fixed atan2_raw(std::int64_t y, std::int64_t x) noexcept {
+
+                if (x == 0 && y == 0) {
+                    return Basic_Fixed{};
+                }
+
+                std::int64_t angle = 0;
+                if constexpr (Fraction > LOOKUP_MAX_FRACTION) {
+                    angle = cordic_atan2(y, x);
+                }
+                else {
+                    // the first octant, atan(low / high) for the ratio in [0, 1]
+                    const std::int64_t ax = x < 0 ? -x : x, ay = y < 0 ? -y : y;
+                    const bool steep = ay > ax;
+                    std::int64_t low = steep ? ax : ay, high = steep ? ay : ax;
+                    while (high >= (std::int64_t(1) << 32)) {
+                        low >>= 1;
+                        high >>= 1;
+                    }
+
+                    // floor(low / high) in Q30, seeded by the double quotient
+                    // and corrected in integers as isqrt is
+                    const std::int64_t scaled = low << 30;
+                    std::int64_t ratio = static_cast<std::int64_t>(static_cast<double>(scaled) / static_cast<double>(high));
+                    while (ratio * high > scaled) {
+                        ratio--;
+                    }
+                    while ((ratio + 1) * high <= scaled) {
+                        ratio++;
+                    }
+
+                    constexpr std::int32_t SHIFT = 30 - ATAN_STEPS_LOG;
+                    const std::int64_t index = std::min<std::int64_t>(ratio >> SHIFT, ATAN_STEPS - 1);
+                    const std::int64_t part = ratio - (index << SHIFT);
+                    angle = ATAN_LOOKUP[index] + (((std::int64_t(ATAN_LOOKUP[index + 1]) - ATAN_LOOKUP[index]) * part) >> SHIFT);
+
+                    angle = steep ? HALF_PI_Q30 - angle : angle;
+                    angle = x < 0 ? PI_Q30 - angle : angle;
+                    angle = y < 0 ? -angle : angle;
+                }
+
+                const std::int64_t half = std::int64_t(1) << (29 - Fraction);
+                return from_raw(static_cast<std::int32_t>((angle + half) >> (30 - Fraction)));
+            }
+
+            // atan(ratio) in [-pi / 2, pi / 2]
+            [[nodiscard]]
+            static constexpr Basic_Fixed atan(Basic_Fixed ratio) noexcept {
+                return atan2(ratio, Basic_Fixed(1));
+            }
+
+            [[nodiscard]]
+            static constexpr Basic_Fixed pi() noexcept {
+                return from_raw(static_cast<std::int32_t>((PI_Q30 + (std::int64_t(1) << (29 - Fraction))) >> (30 - Fraction)));
+            }
+
+        private:
+
+            // Angle of (x, y) in Q2.30 radians in [-pi, pi] by CORDIC
+            // vectoring, (x, y) not both 0
+            [[nodiscard]]
+            static constexpr std::int64_t cordic_atan2(std::int64_t y, std::int64_t x) noexcept {
+
+                std::int64_t vx = x, vy = y;
+
+                // rotate into the right half plane first, CORDIC converges there
+                std::int64_t angle = 0;
+                if (vx < 0) {
+                    angle = vy >= 0 ? PI_Q30 : -PI_Q30;
+                    vx = -vx;
+                    vy = -vy;
+                }
+
+                // scale up for the precision of the shifts below
+                while (std::max(vx, vy < 0 ? -vy : vy) < (std::int64_t(1) << 30)) {
+                    vx *= 2;
+                    vy *= 2;
+                }
+
+                // rotate towards y = 0, the direction picked by a sign mask
+                // (0 or -1) since the branch would mispredict half the time
+                for (std::size_t i = 0; i < ATAN_TABLE.size(); i++) {
+                    const std::int64_t dx = vx >> i, dy = vy >> i;
+                    const std::int64_t flip = -std::int64_t(vy <= 0);
+                    vx += (dy ^ flip) - flip;
+                    vy -= (dx ^ flip) - flip;
+                    angle += (ATAN_TABLE[i] ^ flip) - flip;
+                }
+                return angle;
+            }
+
+            [[nodiscard]]
+            static constexpr std::array<std::int32_t, ATAN_STEPS + 1> atan_lookup() noexcept {
+                std::array<std::int32_t, ATAN_STEPS + 1> table {};
+                for (std::int32_t i = 0; i <= ATAN_STEPS; i++) {
+                    table[i] = static_cast<std::int32_t>(cordic_atan2(i, ATAN_STEPS));
+                }
+                return table;
+            }
+
+            // atan(i / ATAN_STEPS) in Q2.30 radians, built by the CORDIC above
+            // at compile time so it is the same everywhere
+            static constexpr std::array<std::int32_t, ATAN_STEPS + 1> ATAN_LOOKUP = atan_lookup();
+    };
+
+    using Fixed = Basic_Fixed<16>;
+
+    template<typename Type>
+    struct is_fixed : std::false_type {};
+
+    template<std::int32_t Fraction>
+    struct is_fixed<Basic_Fixed<Fraction>> : std::true_type {};
+
+    template<typename Type>
+    inline constexpr bool is_fixed_v = is_fixed<Type>::value;
+
+    // What Vector2 can hold
+    template<typename Type>
+    inline constexpr bool is_vector2_component_v = std::is_arithmetic_v<Type> || is_fixed_v<Type>;
+
+    // The type of Vector2's lengths and angles: double, or the fixed point
+    // type itself so those stay deterministic
+    template<typename Type>
+    using vector2_real_t = std::conditional_t<is_fixed_v<Type>, Type, double>;
+
     //Mathematical Bidimensional Vector
-    template<typename Type, typename = std::enable_if_t<std::is_arithmetic_v<Type>>>
+    template<typename Type, typename = std::enable_if_t<is_vector2_component_v<Type>>>
     class Vector2{
 
         public:
@@ -28,37 +376,82 @@ namespace boar{
             ///////////////////////Mathematical Methods/////////////////////////////////
 
             //Returns diagonal distance between vectors
-            inline double DistanceTo(const Vector2& target) const noexcept {
-                // const double DistX = (double)target.x - (double)this->x;
-                // const double DistY = (double)target.y - (double)this->y;
-                return sqrt(pow(((double)target.x - (double)this->x), 2) + pow(((double)target.y - (double)this->y), 2));
+            //Vector2<Fixed> methods stay in Fixed and use only integer math
+            inline vector2_real_t<Type> DistanceTo(const Vector2& target) const noexcept {
+                if constexpr (is_fixed_v<Type>) {
+                    // exact deltas, two far apart values overflow int32_t
+                    return Type::hypot_raw(std::int64_t(target.x.raw()) - this->x.raw(), std::int64_t(target.y.raw()) - this->y.raw());
+                }
+                else {
+                    // const double DistX = (double)target.x - (double)this->x;
+                    // const double DistY = (double)target.y - (double)this->y;
+                    return sqrt(pow(((double)target.x - (double)this->x), 2) + pow(((double)target.y - (double)this->y), 2));
+                }
             }
             
             // Returns the angle between two vectors in radians
-            inline double AngleTo(const Vector2& target) const noexcept {  
-                // const double DistX = (double)target.x - (double)this->x;
-                // const double DistY = (double)target.y - (double)this->y;
-                return atan(((double)target.y - (double)this->y) / ((double)target.x - (double)this->x));
+            inline vector2_real_t<Type> AngleTo(const Vector2& target) const noexcept {  
+                if constexpr (is_fixed_v<Type>) {
+                    // atan(dy / dx) as below
+                    const std::int64_t dx = std::int64_t(target.x.raw()) - this->x.raw();
+                    const std::int64_t dy = std::int64_t(target.y.raw()) - this->y.raw();
+                    return dx < 0 ? Type::atan2_raw(-dy, -dx) : Type::atan2_raw(dy, dx);
+                }
+                else {
+                    // const double DistX = (double)target.x - (double)this->x;
+                    // const double DistY = (double)target.y - (double)this->y;
+                    return atan(((double)target.y - (double)this->y) / ((double)target.x - (double)this->x));
+                }
             }
 
 
             //Returns the dot product of two vectors
-            inline double DotProduct(const Vector2& target) const noexcept {
-                return ((double)this->x * (double)target.x) + ((double)this->y * (double)target.y);
+            inline vector2_real_t<Type> DotProduct(const Vector2& target) const noexcept {
+                if constexpr (is_fixed_v<Type>) {
+                    return this->x * target.x + this->y * target.y;
+                }
+                else {
+                    return ((double)this->x * (double)target.x) + ((double)this->y * (double)target.y);
+                }
             }
 
             //Returns the magnitude of the Vector2
             [[nodiscard]]
-            inline double Magnitude() const noexcept{
+            inline vector2_real_t<Type> Magnitude() const noexcept{
                 return this->DistanceTo(Vector2<Type>{0,0});
             }
 
-            //Returns the Vector2 normalized
+            //Returns whether target is at most radius away, DistanceTo(target) <= radius
+            //without the square root
             [[nodiscard]]
-            inline Vector2<double> Normalized() const noexcept{
-                const auto magnitude = this->Magnitude();
-                return Vector2<double>{this->x/magnitude, this->y/magnitude};
+            inline bool WithinDistance(const Vector2& target, vector2_real_t<Type> radius) const noexcept {
+                if constexpr (is_fixed_v<Type>) {
+                    return Type::within_raw(std::int64_t(target.x.raw()) - this->x.raw(), std::int64_t(target.y.raw()) - this->y.raw(), radius);
+                }
+                else {
+                    const double dx = (double)target.x - (double)this->x;
+                    const double dy = (double)target.y - (double)this->y;
+                    return radius >= 0 && dx * dx + dy * dy <= radius * radius;
+                }
+            }
 
+            //Returns the Vector2 normalized, a zero Vector2<Fixed> stays zero
+            [[nodiscard]]
+            inline Vector2<vector2_real_t<Type>> Normalized() const noexcept{
+                if constexpr (is_fixed_v<Type>) {
+                    // unsaturated length, the squares of int32_t fit in uint64_t
+                    const std::int64_t x = this->x.raw(), y = this->y.raw();
+                    const std::int64_t length = static_cast<std::int64_t>(Type::isqrt(std::uint64_t(x * x) + std::uint64_t(y * y)));
+                    if (length == 0) {
+                        return *this;
+                    }
+                    return Vector2<Type>{Type::from_raw(static_cast<std::int32_t>(x * Type::ONE / length)),
+                                         Type::from_raw(static_cast<std::int32_t>(y * Type::ONE / length))};
+                }
+                else {
+                    const auto magnitude = this->Magnitude();
+                    return Vector2<vector2_real_t<Type>>{this->x/magnitude, this->y/magnitude};
+                }
             }
             
             [[nodiscard]]
@@ -145,6 +538,10 @@ namespace boar{
                 return Vector2<int64_t>{(int64_t)this->x, (int64_t)this->y};
             }
 
+            inline operator Vector2<Fixed>() const noexcept {
+                return Vector2<Fixed>{Fixed((double)this->x), Fixed((double)this->y)};
+            }
+
             // SFML compatibility
             #ifdef SFML_VECTOR2_HPP
 
@@ -170,6 +567,409 @@ namespace boar{
     using Vector2f  = Vector2<double>;
     using Vector2li = Vector2<int64_t>;
 
+    // Allocator whose blocks start on Alignment byte boundaries, for the SIMD
+    // loads of the batch containers
+    template<typename T, std::size_t Alignment = 64>
+    struct AlignedAllocator {
+
+        using value_type = T;
+
+        template<typename U>
+        struct rebind {
+            using other = AlignedAllocator<U, Alignment>;
+        };
+
+        AlignedAllocator() noexcept = default;
+
+        template<typename U>
+        AlignedAllocator(const AlignedAllocator<U, Alignment>&) noexcept {}
+
+        [[nodiscard]]
+        T* allocate(std::size_t count) {
+            return static_cast<T*>(::operator new(count * sizeof(T), std::align_val_t(Alignment)));
+        }
+
+        void deallocate(T* block, std::size_t) noexcept {
+            ::operator delete(block, std::align_val_t(Alignment));
+        }
+
+        template<typename U>
+        inline bool operator==(const AlignedAllocator<U, Alignment>&) const noexcept {
+            return true;
+        }
+
+        template<typename U>
+        inline bool operator!=(const AlignedAllocator<U, Alignment>&) const noexcept {
+            return false;
+        }
+    };
+
+    // SIMD lanes for Vector2Array's batch operations, a reg holds size
+    // values of T. The scalar one is the fallback and runs the tails
+    template<typename T>
+    struct Vector2ScalarLanes {
+        using reg = T;
+        static constexpr std::size_t size = 1;
+
+        static inline reg load(const T* from) noexcept { return *from; }
+        static inline void store(T* to, reg value) noexcept { *to = value; }
+        static inline reg set1(T value) noexcept { return value; }
+        static inline reg add(reg a, reg b) noexcept { return a + b; }
+        static inline reg sub(reg a, reg b) noexcept { return a - b; }
+        static inline reg mul(reg a, reg b) noexcept { return a * b; }
+        static inline reg div(reg a, reg b) noexcept { return a / b; }
+        static inline reg sqrt(reg a) noexcept { return std::sqrt(a); }
+        // value where test > 0, 0 elsewhere
+        static inline reg if_positive(reg test, reg value) noexcept { return test > 0 ? value : 0; }
+    };
+
+    template<typename T>
+    struct Vector2Lanes : Vector2ScalarLanes<T> {};
+
+#if defined(BOAR_SIMD_AVX2)
+    template<>
+    struct Vector2Lanes<float> {
+        using reg = __m256;
+        static constexpr std::size_t size = 8;
+
+        static inline reg load(const float* from) noexcept { return _mm256_loadu_ps(from); }
+        static inline void store(float* to, reg value) noexcept { _mm256_storeu_ps(to, value); }
+        static inline reg set1(float value) noexcept { return _mm256_set1_ps(value); }
+        static inline reg add(reg a, reg b) noexcept { return _mm256_add_ps(a, b); }
+        static inline reg sub(reg a, reg b) noexcept { return _mm256_sub_ps(a, b); }
+        static inline reg mul(reg a, reg b) noexcept { return _mm256_mul_ps(a, b); }
+        static inline reg div(reg a, reg b) noexcept { return _mm256_div_ps(a, b); }
+        static inline reg sqrt(reg a) noexcept { return _mm256_sqrt_ps(a); }
+        static inline reg if_positive(reg test, reg value) noexcept {
+            return _mm256_and_ps(_mm256_cmp_ps(test, _mm256_setzero_ps(), _CMP_GT_OQ), value);
+        }
+    };
+
+    template<>
+    struct Vector2Lanes<double> {
+        using reg = __m256d;
+        static constexpr std::size_t size = 4;
+
+        static inline reg load(const double* from) noexcept { return _mm256_loadu_pd(from); }
+        static inline void store(double* to, reg value) noexcept { _mm256_storeu_pd(to, value); }
+        static inline reg set1(double value) noexcept { return _mm256_set1_pd(value); }
+        static inline reg add(reg a, reg b) noexcept { return _mm256_add_pd(a, b); }
+        static inline reg sub(reg a, reg b) noexcept { return _mm256_sub_pd(a, b); }
+        static inline reg mul(reg a, reg b) noexcept { return _mm256_mul_pd(a, b); }
+        static inline reg div(reg a, reg b) noexcept { return _mm256_div_pd(a, b); }
+        static inline reg sqrt(reg a) noexcept { return _mm256_sqrt_pd(a); }
+        static inline reg if_positive(reg test, reg value) noexcept {
+            return _mm256_and_pd(_mm256_cmp_pd(test, _mm256_setzero_pd(), _CMP_GT_OQ), value);
+        }
+    };
+#elif defined(BOAR_SIMD_SSE2)
+    template<>
+    struct Vector2Lanes<float> {
+        using reg = __m128;
+        static constexpr std::size_t size = 4;
+
+        static inline reg load(const float* from) noexcept { return _mm_loadu_ps(from); }
+        static inline void store(float* to, reg value) noexcept { _mm_storeu_ps(to, value); }
+        static inline reg set1(float value) noexcept { return _mm_set1_ps(value); }
+        static inline reg add(reg a, reg b) noexcept { return _mm_add_ps(a, b); }
+        static inline reg sub(reg a, reg b) noexcept { return _mm_sub_ps(a, b); }
+        static inline reg mul(reg a, reg b) noexcept { return _mm_mul_ps(a, b); }
+        static inline reg div(reg a, reg b) noexcept { return _mm_div_ps(a, b); }
+        static inline reg sqrt(reg a) noexcept { return _mm_sqrt_ps(a); }
+        static inline reg if_positive(reg test, reg value) noexcept {
+            return _mm_and_ps(_mm_cmpgt_ps(test, _mm_setzero_ps()), value);
+        }
+    };
+
+    template<>
+    struct Vector2Lanes<double> {
+        using reg = __m128d;
+        static constexpr std::size_t size = 2;
+
+        static inline reg load(const double* from) noexcept { return _mm_loadu_pd(from); }
+        static inline void store(double* to, reg value) noexcept { _mm_storeu_pd(to, value); }
+        static inline reg set1(double value) noexcept { return _mm_set1_pd(value); }
+        static inline reg add(reg a, reg b) noexcept { return _mm_add_pd(a, b); }
+        static inline reg sub(reg a, reg b) noexcept { return _mm_sub_pd(a, b); }
+        static inline reg mul(reg a, reg b) noexcept { return _mm_mul_pd(a, b); }
+        static inline reg div(reg a, reg b) noexcept { return _mm_div_pd(a, b); }
+        static inline reg sqrt(reg a) noexcept { return _mm_sqrt_pd(a); }
+        static inline reg if_positive(reg test, reg value) noexcept {
+            return _mm_and_pd(_mm_cmpgt_pd(test, _mm_setzero_pd()), value);
+        }
+    };
+#endif
+
+    // Vector2s stored as structure of arrays, all x then all y, so the batch
+    // operations below run several vectors per SIMD instruction. Reads and
+    // writes go through Vector2<T> values
+    template<typename T>
+    class Vector2Array {
+
+        static_assert(std::is_arithmetic_v<T>, "Vector2Array holds arithmetic components");
+
+        public:
+
+            using Storage = std::vector<T, AlignedAllocator<T>>;
+
+            // Walks the array as Vector2<T> values
+            class const_iterator {
+
+                private:
+
+                    const Vector2Array* array;
+                    std::size_t index;
+
+                public:
+
+                    using iterator_category = std::input_iterator_tag;
+                    using value_type = Vector2<T>;
+                    using difference_type = std::ptrdiff_t;
+                    using pointer = void;
+                    using reference = Vector2<T>;
+
+                    const_iterator(const Vector2Array* array, std::size_t index) : array(array), index(index) {}
+
+                    inline Vector2<T> operator*() const noexcept {
+                        return this->array->get(this->index);
+                    }
+
+                    inline const_iterator& operator++() noexcept {
+                        this->index++;
+                        return *this;
+                    }
+
+                    inline const_iterator operator++(int) noexcept {
+                        const_iterator previous = *this;
+                        this->index++;
+                        return previous;
+                    }
+
+                    inline bool operator==(const const_iterator& other) const noexcept {
+                        return this->index == other.index;
+                    }
+
+                    inline bool operator!=(const const_iterator& other) const noexcept {
+                        return this->index != other.index;
+                    }
+            };
+
+        private:
+
+            Storage xs;
+            Storage ys;
+
+        public:
+
+            Vector2Array() = default;
+
+            explicit Vector2Array(std::size_t count, Vector2<T> value = {0, 0})
+            : xs(count, value.x), ys(count, value.y) {}
+
+            template<typename Iterator>
+            Vector2Array(Iterator first, Iterator last) {
+                for (; first != last; ++first) {
+                    this->push_back(*first);
+                }
+            }
+
+            Vector2Array(const std::vector<Vector2<T>>& vectors) : Vector2Array(vectors.begin(), vectors.end()) {}
+
+            [[nodiscard]]
+            inline std::size_t size() const noexcept {
+                return this->xs.size();
+            }
+
+            [[nodiscard]]
+            inline bool empty() const noexcept {
+                return this->xs.empty();
+            }
+
+            void reserve(std::size_t count) {
+                this->xs.reserve(count);
+                this->ys.reserve(count);
+            }
+
+            void resize(std::size_t count, Vector2<T> value = {0, 0}) {
+                this->xs.resize(count, value.x);
+                this->ys.resize(count, value.y);
+            }
+
+            void clear() noexcept {
+                this->xs.clear();
+                this->ys.clear();
+            }
+
+            void push_back(Vector2<T> value) {
+                this->xs.push_back(value.x);
+                this->ys.push_back(value.y);
+            }
+
+            [[nodiscard]]
+            inline Vector2<T> get(std::size_t index) const noexcept {
+                return Vector2<T>{this->xs[index], this->ys[index]};
+            }
+
+            [[nodiscard]]
+            inline Vector2<T> operator[](std::size_t index) const noexcept {
+                return this->get(index);
+            }
+
+            inline void set(std::size_t index, Vector2<T> value) noexcept {
+                this->xs[index] = value.x;
+                this->ys[index] = value.y;
+            }
+
+            // The components, 64 byte aligned
+            [[nodiscard]] inline T* x() noexcept { return this->xs.data(); }
+            [[nodiscard]] inline T* y() noexcept { return this->ys.data(); }
+            [[nodiscard]] inline const T* x() const noexcept { return this->xs.data(); }
+            [[nodiscard]] inline const T* y() const noexcept { return this->ys.data(); }
+
+            [[nodiscard]]
+            inline const_iterator begin() const noexcept {
+                return {this, 0};
+            }
+
+            [[nodiscard]]
+            inline const_iterator end() const noexcept {
+                return {this, this->size()};
+            }
+
+            [[nodiscard]]
+            std::vector<Vector2<T>> to_vector() const {
+                return std::vector<Vector2<T>>(this->begin(), this->end());
+            }
+
+            ///////////////////////Batch Operations/////////////////////////////////
+            // other must be as long as this, out must hold size() values
+
+            Vector2Array& operator+=(const Vector2Array& other) noexcept {
+                this->combine(other, [](auto lanes, auto a, auto b) { return decltype(lanes)::add(a, b); });
+                return *this;
+            }
+
+            Vector2Array& operator-=(const Vector2Array& other) noexcept {
+                this->combine(other, [](auto lanes, auto a, auto b) { return decltype(lanes)::sub(a, b); });
+                return *this;
+            }
+
+            // component by component, as Vector2's operator*
+            Vector2Array& operator*=(const Vector2Array& other) noexcept {
+                this->combine(other, [](auto lanes, auto a, auto b) { return decltype(lanes)::mul(a, b); });
+                return *this;
+            }
+
+            // Adds offset to every vector
+            Vector2Array& operator+=(Vector2<T> offset) noexcept {
+                T* x = this->x();
+                T* y = this->y();
+                each(this->size(), [&](auto lanes, std::size_t i) {
+                    using L = decltype(lanes);
+                    L::store(x + i, L::add(L::load(x + i), L::set1(offset.x)));
+                    L::store(y + i, L::add(L::load(y + i), L::set1(offset.y)));
+                });
+                return *this;
+            }
+
+            Vector2Array& operator*=(T factor) noexcept {
+                T* x = this->x();
+                T* y = this->y();
+                each(this->size(), [&](auto lanes, std::size_t i) {
+                    using L = decltype(lanes);
+                    L::store(x + i, L::mul(L::load(x + i), L::set1(factor)));
+                    L::store(y + i, L::mul(L::load(y + i), L::set1(factor)));
+                });
+                return *this;
+            }
+
+            // out[i] = get(i).DotProduct(other.get(i)), in T
+            void dot(const Vector2Array& other, T* out) const noexcept {
+                const T* x = this->x();
+                const T* y = this->y();
+                const T* other_x = other.x();
+                const T* other_y = other.y();
+                each(this->size(), [&](auto lanes, std::size_t i) {
+                    using L = decltype(lanes);
+                    L::store(out + i, L::add(L::mul(L::load(x + i), L::load(other_x + i)), L::mul(L::load(y + i), L::load(other_y + i))));
+                });
+            }
+
+            void length_squared(T* out) const noexcept {
+                this->dot(*this, out);
+            }
+
+            void length(T* out) const noexcept {
+                static_assert(std::is_floating_point_v<T>, "length needs floating point components");
+                const T* x = this->x();
+                const T* y = this->y();
+                each(this->size(), [&](auto lanes, std::size_t i) {
+                    using L = decltype(lanes);
+                    const auto vx = L::load(x + i), vy = L::load(y + i);
+                    L::store(out + i, L::sqrt(L::add(L::mul(vx, vx), L::mul(vy, vy))));
+                });
+            }
+
+            // Scales every vector to length 1, zero vectors stay zero
+            void normalize() noexcept {
+                static_assert(std::is_floating_point_v<T>, "normalize needs floating point components");
+                T* x = this->x();
+                T* y = this->y();
+                each(this->size(), [&](auto lanes, std::size_t i) {
+                    using L = decltype(lanes);
+                    const auto vx = L::load(x + i), vy = L::load(y + i);
+                    const auto length = L::sqrt(L::add(L::mul(vx, vx), L::mul(vy, vy)));
+                    const auto inverse = L::if_positive(length, L::div(L::set1(1), length));
+                    L::store(x + i, L::mul(vx, inverse));
+                    L::store(y + i, L::mul(vy, inverse));
+                });
+            }
+
+            // out[i] = get(i).DistanceTo(point), in T
+            void distance_to(Vector2<T> point, T* out) const noexcept {
+                static_assert(std::is_floating_point_v<T>, "distance_to needs floating point components");
+                const T* x = this->x();
+                const T* y = this->y();
+                each(this->size(), [&](auto lanes, std::size_t i) {
+                    using L = decltype(lanes);
+                    const auto dx = L::sub(L::load(x + i), L::set1(point.x));
+                    const auto dy = L::sub(L::load(y + i), L::set1(point.y));
+                    L::store(out + i, L::sqrt(L::add(L::mul(dx, dx), L::mul(dy, dy))));
+                });
+            }
+
+        private:
+
+            // op(lanes, i) for every i, Vector2Lanes<T>::size at a time and
+            // the tail one by one. lanes is only there for its type
+            template<typename Op>
+            static inline void each(std::size_t count, const Op& op) noexcept {
+                using Wide = Vector2Lanes<T>;
+                std::size_t i = 0;
+                for (; i + Wide::size <= count; i += Wide::size) {
+                    op(Wide{}, i);
+                }
+                for (; i < count; i++) {
+                    op(Vector2ScalarLanes<T>{}, i);
+                }
+            }
+
+            template<typename Op>
+            inline void combine(const Vector2Array& other, const Op& op) noexcept {
+                T* x = this->x();
+                T* y = this->y();
+                const T* other_x = other.x();
+                const T* other_y = other.y();
+                each(this->size(), [&](auto lanes, std::size_t i) {
+                    using L = decltype(lanes);
+                    L::store(x + i, op(lanes, L::load(x + i), L::load(other_x + i)));
+                    L::store(y + i, op(lanes, L::load(y + i), L::load(other_y + i)));
+                });
+            }
+    };
+
+    using Vector2fArray = Vector2Array<double>;
+
     class Angle{
 
         static double constexpr  PI = 3.14159265;
@@ -187,23 +987,459 @@ namespace boar{
                 return rad;
             };
 
+            // Fixed point versions, integer math through int64_t
+            template<std::int32_t Fraction>
+            constexpr static Basic_Fixed<Fraction> RadToDeg(const Basic_Fixed<Fraction> rad) noexcept {
+                using Real = Basic_Fixed<Fraction>;
+                return Real::from_raw(static_cast<std::int32_t>(std::int64_t(rad.raw()) * 180 * Real::ONE / Real::pi().raw()));
+            }
+
+            template<std::int32_t Fraction>
+            constexpr static Basic_Fixed<Fraction> DegToRad(const Basic_Fixed<Fraction> deg) noexcept {
+                using Real = Basic_Fixed<Fraction>;
+                return Real::from_raw(static_cast<std::int32_t>(std::int64_t(deg.raw()) * Real::pi().raw() / (std::int64_t(180) * Real::ONE)));
+            }
+
     };
 
 
-    class Draw{
+    // Draw sinks. A sink receives plot(x, y) for single pixels and
+    // span(y, x0, x1) for the horizontal runs [x0, x1], x0 <= x1
+
+    // Calls plot(x, y) once per pixel
+    template<typename Plot>
+    class PlotSink{
+        public:
+            Plot plot_func;
+
+            template<typename Other, typename = std::enable_if_t<!std::is_same_v<std::decay_t<Other>, PlotSink>>>
+            PlotSink(Other&& plot_func): plot_func(std::forward<Other>(plot_func)){}
+
+            inline void plot(int x, int y) const {
+                this->plot_func(x, y);
+            }
+
+            inline void span(int y, int x0, int x1) const {
+                for (int x = x0; x <= x1; x++) {
+                    this->plot_func(x, y);
+                }
+            }
+    };
+
+    template<typename Plot>
+    PlotSink(Plot) -> PlotSink<Plot>;
+
+    // Calls span(y, x0, x1) once per horizontal run, single pixels are runs
+    // of one
+    template<typename Span>
+    class SpanSink{
+        public:
+            Span span_func;
+
+            template<typename Other, typename = std::enable_if_t<!std::is_same_v<std::decay_t<Other>, SpanSink>>>
+            SpanSink(Other&& span_func): span_func(std::forward<Other>(span_func)){}
+
+            inline void plot(int x, int y) const {
+                this->span_func(y, x, x);
+            }
+
+            inline void span(int y, int x0, int x1) const {
+                this->span_func(y, x0, x1);
+            }
+    };
+
+    template<typename Span>
+    SpanSink(Span) -> SpanSink<Span>;
+
+    // Writes color into a caller owned width x height image whose rows are
+    // stride pixels apart. Clips to the image
+    template<typename Pixel>
+    class FramebufferSink{
+        private:
+            Pixel* pixels;
+            int width;
+            int height;
+            std::ptrdiff_t stride;
+
+        public:
+            Pixel color;
+
+            FramebufferSink(Pixel* pixels, int width, int height, std::ptrdiff_t stride, Pixel color)
+            : pixels{pixels}, width{width}, height{height}, stride{stride}, color{color}{}
+
+            inline void plot(int x, int y) const noexcept {
+                if (x >= 0 && x < this->width && y >= 0 && y < this->height) {
+                    this->pixels[y * this->stride + x] = this->color;
+                }
+            }
+
+            inline void span(int y, int x0, int x1) const noexcept {
+                if (y < 0 || y >= this->height) {
+                    return;
+                }
+                x0 = std::max(x0, 0);
+                x1 = std::min(x1, this->width - 1);
+                if (x0 <= x1) {
+                    std::fill_n(this->pixels + y * this->stride + x0, x1 - x0 + 1, this->color);
+                }
+            }
+    };
+
+    // Rasterizes into Sink. The sink type is a template parameter so its
+    // calls inline. Basic_Draw is a Sink, so the sink's public members are
+    // the draw's: Draw keeps the std::function plot_func interface
+    template<typename Sink>
+    class Basic_Draw: public Sink{
     public:
         // Receives a function with two int arguments and returns nothing to draw
-        using PlotType = std::function<void (int,int)>;   
-        PlotType plot_func;
-        Draw(PlotType plot_func): plot_func{plot_func}{}
-        
-        // Draw and line with plot_func using Bresenham's_line_algorithm
+        using PlotType = std::function<void (int,int)>;
+
+        Basic_Draw(Sink sink): Sink{std::move(sink)}{}
+
+        inline Sink& sink() noexcept {
+            return *this;
+        }
+
+        // Draw a line with Bresenham's line algorithm, the pixels of each
+        // row go to the sink as one span
+        template<typename T>
+        void line(const Vector2<T>& init, const Vector2<T>& end) const {
+            this->line(init, static_cast<int>(end.x), static_cast<int>(end.y));
+        }
+
+        template<typename T>
+        void line(const Vector2<T>& init, int x_end, int y_end) const {
+
+            int x = static_cast<int>(init.x);
+            int y = static_cast<int>(init.y);
+            const int dx = std::abs(x_end - x);
+            const int dy = -std::abs(y_end - y);
+            const int step_x = x < x_end ? 1 : -1;
+            const int step_y = y < y_end ? 1 : -1;
+            int error = dx + dy;
+            int run = x;
+
+            while (x != x_end || y != y_end) {
+                const int error2 = 2 * error;
+                if (error2 <= dx) {
+                    // leaving this row
+                    this->span(y, std::min(run, x), std::max(run, x));
+                    if (error2 >= dy) {
+                        error += dy;
+                        x += step_x;
+                    }
+                    error += dx;
+                    y += step_y;
+                    run = x;
+                }
+                else {
+                    error += dy;
+                    x += step_x;
+                }
+            }
+            this->span(y, std::min(run, x), std::max(run, x));
+        }
+
+        // Outline of a circle with the midpoint algorithm, every pixel once
+        template<typename T>
+        void circle(const Vector2<T>& center, int radius) const {
+
+            const int cx = static_cast<int>(center.x);
+            const int cy = static_cast<int>(center.y);
+            if (radius < 0) {
+                return;
+            }
+            if (radius == 0) {
+                this->plot(cx, cy);
+                return;
+            }
+
+            int x = radius, y = 0, error = 1 - radius;
+            while (x >= y) {
+                if (y == 0) {
+                    this->plot(cx + x, cy);
+                    this->plot(cx - x, cy);
+                    this->plot(cx, cy + x);
+                    this->plot(cx, cy - x);
+                }
+                else {
+                    this->plot(cx + x, cy + y);
+                    this->plot(cx - x, cy + y);
+                    this->plot(cx + x, cy - y);
+                    this->plot(cx - x, cy - y);
+                    if (x != y) {
+                        this->plot(cx + y, cy + x);
+                        this->plot(cx - y, cy + x);
+                        this->plot(cx + y, cy - x);
+                        this->plot(cx - y, cy - x);
+                    }
+                }
+                this->midpoint_step(x, y, error);
+            }
+        }
+
+        // Filled circle, one span per row, same pixels as circle() and inside
+        template<typename T>
+        void fill_circle(const Vector2<T>& center, int radius) const {
+
+            const int cx = static_cast<int>(center.x);
+            const int cy = static_cast<int>(center.y);
+            if (radius < 0) {
+                return;
+            }
+
+            int x = radius, y = 0, error = 1 - radius;
+            while (x >= y) {
+                this->span(cy + y, cx - x, cx + x);
+                if (y != 0) {
+                    this->span(cy - y, cx - x, cx + x);
+                }
+                const int last_x = x, last_y = y;
+                this->midpoint_step(x, y, error);
+                // rows cy +- last_x are done once x moves on, y is their widest
+                if (x != last_x && last_x != last_y) {
+                    this->span(cy + last_x, cx - last_y, cx + last_y);
+                    this->span(cy - last_x, cx - last_y, cx + last_y);
+                }
+            }
+        }
+
+        template<typename T>
+        void fill_triangle(const Vector2<T>& a, const Vector2<T>& b, const Vector2<T>& c) const {
+            const Vector2<T> points[] = {a, b, c};
+            this->fill_polygon(points, 3);
+        }
+
+        // Filled simple or self intersecting polygon with the even-odd rule.
+        // Fills the pixels whose centers are inside or on an edge, scanline
+        // by scanline, one span per pair of edge crossings
         template<typename T>
-        void line(const Vector2<T>& init, const Vector2<T>& end) const;
+        void fill_polygon(const Vector2<T>* points, std::size_t count) const {
+
+            if (count == 0) {
+                return;
+            }
+
+            double top = static_cast<double>(points[0].y), bottom = top;
+            for (std::size_t i = 1; i < count; i++) {
+                top = std::min(top, static_cast<double>(points[i].y));
+                bottom = std::max(bottom, static_cast<double>(points[i].y));
+            }
+            const int first_row = static_cast<int>(std::ceil(top));
+            const int last_row = static_cast<int>(std::floor(bottom));
+
+            std::vector<double> crossings;
+            for (int row = first_row; row <= last_row; row++) {
+
+                crossings.clear();
+                for (std::size_t i = 0; i < count; i++) {
+                    const Vector2<T>& from = points[i];
+                    const Vector2<T>& to = points[i + 1 == count ? 0 : i + 1];
+                    double x0 = static_cast<double>(from.x), y0 = static_cast<double>(from.y);
+                    double x1 = static_cast<double>(to.x), y1 = static_cast<double>(to.y);
+                    if (y0 > y1) {
+                        std::swap(x0, x1);
+                        std::swap(y0, y1);
+                    }
+                    // half open so shared vertices count once, except on
+                    // the bottom row where nothing continues past them
+                    if (y0 == y1 || row < y0 || row > y1 || (row == y1 && y1 != bottom)) {
+                        continue;
+                    }
+                    crossings.push_back(x0 + (row - y0) * (x1 - x0) / (y1 - y0));
+                }
+
+                std::sort(crossings.begin(), crossings.end());
+                int previous = std::numeric_limits<int>::min();
+                for (std::size_t i = 0; i + 1 < crossings.size(); i += 2) {
+                    // spans meeting on a pixel center share it, send it once
+                    const int x0 = std::max(static_cast<int>(std::ceil(crossings[i])), previous + 1);
+                    const int x1 = static_cast<int>(std::floor(crossings[i + 1]));
+                    if (x0 <= x1) {
+                        this->span(row, x0, x1);
+                        previous = x1;
+                    }
+                }
+            }
+        }
+
         template<typename T>
-        void line(const Vector2<T>& init, int x_end, int y_end) const;
-        
-        void circle();
+        void fill_polygon(const std::vector<Vector2<T>>& points) const {
+            this->fill_polygon(points.data(), points.size());
+        }
+
+    private:
+        static void midpoint_step(int& x, int& y, int& error) noexcept {
+            y++;
+            if (error < 0) {
+                error += 2 * y + 1;
+            }
+            else {
+                x--;
+                error += 2 * (y - x) + 1;
+            }
+        }
+    };
+
+    using Draw = Basic_Draw<PlotSink<std::function<void (int,int)>>>;
+
+
+    // Fixed set of worker threads with a job queue each. Jobs submitted from
+    // outside the pool are dealt round robin, jobs submitted from inside a job
+    // go to that worker's own queue. A worker runs its newest job first and
+    // an idle one steals the oldest job of a busy one
+    class ThreadPool {
+
+        private:
+
+            struct Queue {
+                std::mutex mutex;
+                std::deque<std::function<void()>> jobs;
+            };
+
+            std::vector<std::thread> workers;
+            std::vector<std::unique_ptr<Queue>> queues;
+            std::atomic<std::size_t> next_queue {0};
+
+            std::mutex mutex;
+            std::condition_variable wake;
+            // jobs queued and not yet claimed by a worker
+            std::size_t pending = 0;
+            bool stopping = false;
+
+            // the pool and queue of the worker running on this thread
+            static inline thread_local const ThreadPool* current_pool = nullptr;
+            static inline thread_local std::size_t current_queue = 0;
+
+        public:
+
+            ThreadPool(std::size_t threads = std::thread::hardware_concurrency()) {
+
+                threads = std::max<std::size_t>(threads, 1);
+                for (std::size_t i = 0; i < threads; i++) {
+                    this->queues.push_back(std::make_unique<Queue>());
+                }
+                for (std::size_t i = 0; i < threads; i++) {
+                    this->workers.emplace_back([this, i]() { this->work(i); });
+                }
+            }
+
+            ~ThreadPool() {
+                {
+                    std::lock_guard<std::mutex> lock(this->mutex);
+                    this->stopping = true;
+                }
+                this->wake.notify_all();
+                for (auto& i: this->workers) {
+                    i.join();
+                }
+            }
+
+            ThreadPool(const ThreadPool&) = delete;
+            ThreadPool& operator=(const ThreadPool&) = delete;
+
+            [[nodiscard]]
+            inline std::size_t size() const noexcept {
+                return this->workers.size();
+            }
+
+            // Queues job and returns a future for its result
+            template<typename Job>
+            auto submit(Job job) -> std::future<std::invoke_result_t<Job>> {
+
+                using Result = std::invoke_result_t<Job>;
+                auto task = std::make_shared<std::packaged_task<Result()>>(std::move(job));
+                std::future<Result> result = task->get_future();
+
+                const std::size_t queue = current_pool == this ? current_queue : this->next_queue++ % this->queues.size();
+                {
+                    std::lock_guard<std::mutex> lock(this->queues[queue]->mutex);
+                    this->queues[queue]->jobs.push_back([task]() { (*task)(); });
+                }
+                {
+                    std::lock_guard<std::mutex> lock(this->mutex);
+                    this->pending++;
+                }
+                this->wake.notify_one();
+                return result;
+            }
+
+            // Calls job(i, worker) for every i in [0, count) and blocks until all
+            // calls return. worker is in [0, size()) and no two calls with the
+            // same worker run at once, so it can index per-thread scratch data.
+            // Must not be called from inside one of the pool's jobs
+            template<typename Job>
+            void parallel_for(std::size_t count, const Job& job) {
+
+                std::atomic<std::size_t> next {0};
+                std::vector<std::future<void>> running;
+
+                const std::size_t used = std::min(this->size(), count);
+                for (std::size_t worker = 0; worker < used; worker++) {
+                    running.push_back(this->submit([&next, &job, count, worker]() {
+                        for (std::size_t i = next++; i < count; i = next++) {
+                            job(i, worker);
+                        }
+                    }));
+                }
+                for (auto& i: running) {
+                    i.wait();
+                }
+                for (auto& i: running) {
+                    i.get();
+                }
+            }
+
+        private:
+
+            void work(std::size_t index) {
+
+                current_pool = this;
+                current_queue = index;
+
+                while (true) {
+                    {
+                        std::unique_lock<std::mutex> lock(this->mutex);
+                        this->wake.wait(lock, [this]() { return this->stopping || this->pending > 0; });
+                        if (this->stopping && this->pending == 0) {
+                            return;
+                        }
+                        this->pending--;
+                    }
+
+                    // the claimed job is queued somewhere, but another worker
+                    // may have taken the one seen first
+                    std::function<void()> job;
+                    while (!(job = this->take(index))) {
+                        std::this_thread::yield();
+                    }
+                    job();
+                }
+            }
+
+            std::function<void()> take(std::size_t index) {
+
+                {
+                    Queue& own = *this->queues[index];
+                    std::lock_guard<std::mutex> lock(own.mutex);
+                    if (!own.jobs.empty()) {
+                        std::function<void()> job = std::move(own.jobs.back());
+                        own.jobs.pop_back();
+                        return job;
+                    }
+                }
+
+                for (std::size_t i = 1; i < this->queues.size(); i++) {
+                    Queue& victim = *this->queues[(index + i) % this->queues.size()];
+                    std::lock_guard<std::mutex> lock(victim.mutex);
+                    if (!victim.jobs.empty()) {
+                        std::function<void()> job = std::move(victim.jobs.front());
+                        victim.jobs.pop_front();
+                        return job;
+                    }
+                }
+                return {};
+            }
     };
 
 }